@@ -0,0 +1,347 @@
+#include "AsyncFileWriter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "BoundedQueue.h"
+#include "ChunkCodec.h"
+
+#if defined(_WIN32)
+#include <cstdio>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
+#if defined(HAVE_LIBURING)
+#include <liburing.h>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Blocking write of a whole file. Windows has no pwrite and files are not
+// synced there.
+bool write_whole_file(const std::string& file_name, std::string_view data,
+                      bool sync, double& fsync_seconds) {
+#if defined(_WIN32)
+  return write_file(file_name, data);
+#else
+  int fd = open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                0644);
+  if (fd < 0) return false;
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t n = pwrite(fd, data.data() + written, data.size() - written,
+                       static_cast<off_t>(written));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    written += n;
+  }
+  bool ok = written == data.size();
+  if (ok && sync) {
+    auto start = Clock::now();
+    ok = fsync(fd) == 0;
+    fsync_seconds = seconds_since(start);
+  }
+  return close(fd) == 0 && ok;
+#endif
+}
+
+class ThreadsFileWriter : public AsyncFileWriter {
+ public:
+  ThreadsFileWriter(size_t max_in_flight, bool sync)
+      : AsyncFileWriter(max_in_flight, sync), jobs(this->max_in_flight) {
+    for (size_t i = 0; i < this->max_in_flight; ++i) {
+      threads.emplace_back([this] { Run(); });
+    }
+  }
+  ~ThreadsFileWriter() override { Finish(); }
+
+  const char* name() const override { return "threads"; }
+
+  void Finish() override {
+    jobs.Close();
+    for (auto& thread : threads) thread.join();
+    threads.clear();
+  }
+
+ private:
+  void Queue(Job job) override { jobs.Push(std::move(job)); }
+
+  void Run() {
+    while (auto job = jobs.Pop()) {
+      double fsync_seconds = 0;
+      bool ok = write_whole_file(job->file_name, job->data, sync,
+                                 fsync_seconds);
+      Done(*job, ok, fsync_seconds);
+    }
+  }
+
+  BoundedQueue<Job> jobs;
+  std::vector<std::thread> threads;
+};
+
+#if defined(HAVE_LIBURING)
+class IoUringFileWriter : public AsyncFileWriter {
+ public:
+  IoUringFileWriter(size_t max_in_flight, bool sync)
+      : AsyncFileWriter(max_in_flight, sync), jobs(this->max_in_flight) {
+    // Every file in flight has a single SQE outstanding. This fails without
+    // kernel support, or where seccomp forbids io_uring.
+    init_result = io_uring_queue_init(this->max_in_flight, &ring, 0);
+    if (ok() && !SupportsFileOps()) {
+      io_uring_queue_exit(&ring);
+      init_result = -EOPNOTSUPP;
+    }
+    if (ok()) thread = std::thread([this] { Run(); });
+  }
+  ~IoUringFileWriter() override {
+    Finish();
+    if (ok()) io_uring_queue_exit(&ring);
+  }
+
+  const char* name() const override { return "io_uring"; }
+
+  bool ok() const { return init_result == 0; }
+  int error() const { return -init_result; }
+
+  void Finish() override {
+    jobs.Close();
+    if (thread.joinable()) thread.join();
+  }
+
+ private:
+  // One file moving through open, write, fsync and close. Every step is a
+  // single SQE whose completion queues the next one.
+  struct File {
+    Job job;
+    enum { kOpen, kWrite, kSync, kClose } step = kOpen;
+    int fd = -1;
+    size_t written = 0;
+    bool ok = true;
+    Clock::time_point sync_start;
+    double fsync_seconds = 0;
+  };
+
+  void Queue(Job job) override { jobs.Push(std::move(job)); }
+
+  // Kernels before 5.6 set up a ring but have no openat or close
+  // operations, and no probe either.
+  bool SupportsFileOps() {
+    io_uring_probe* probe = io_uring_get_probe_ring(&ring);
+    if (nullptr == probe) return false;
+    bool supported = true;
+    for (int op : {IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_FSYNC,
+                   IORING_OP_CLOSE}) {
+      supported = supported && io_uring_opcode_supported(probe, op);
+    }
+    io_uring_free_probe(probe);
+    return supported;
+  }
+
+  void Run() {
+    size_t in_flight = 0;
+    bool input_done = false;
+    while (true) {
+      // Start as many new files as there is room for, so that their opens
+      // are submitted together. Only wait for a job when nothing is in
+      // flight.
+      while (!input_done && in_flight < max_in_flight) {
+        auto job = in_flight == 0 ? jobs.Pop() : jobs.TryPop();
+        if (!job) {
+          if (in_flight == 0) input_done = true;
+          break;
+        }
+        auto* file = new File{std::move(*job)};
+        io_uring_prep_openat(Sqe(file), AT_FDCWD, file->job.file_name.c_str(),
+                             O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        in_flight++;
+      }
+      if (in_flight == 0) break;
+
+      io_uring_submit_and_wait(&ring, 1);
+      io_uring_cqe* cqe;
+      unsigned head;
+      unsigned completed = 0;
+      io_uring_for_each_cqe(&ring, head, cqe) {
+        auto* file = static_cast<File*>(io_uring_cqe_get_data(cqe));
+        if (!Advance(*file, cqe->res)) {
+          Done(file->job, file->ok, file->fsync_seconds);
+          delete file;
+          in_flight--;
+        }
+        completed++;
+      }
+      io_uring_cq_advance(&ring, completed);
+    }
+  }
+
+  io_uring_sqe* Sqe(File* file) {
+    io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+    io_uring_sqe_set_data(sqe, file);
+    return sqe;
+  }
+
+  // Queues the next step of file after a step completed with result res.
+  // Returns false once the file is closed, or could not be opened.
+  bool Advance(File& file, int res) {
+    switch (file.step) {
+      case File::kOpen:
+        if (res < 0) {
+          file.ok = false;
+          return false;
+        }
+        file.fd = res;
+        file.step = File::kWrite;
+        break;
+      case File::kWrite:
+        if (res == -EINTR || res == -EAGAIN) break;
+        if (res <= 0) {
+          file.ok = false;
+          file.step = File::kClose;
+          break;
+        }
+        file.written += res;
+        if (file.written == file.job.data.size()) {
+          file.step = sync ? File::kSync : File::kClose;
+        }
+        break;
+      case File::kSync:
+        file.fsync_seconds = seconds_since(file.sync_start);
+        if (res < 0) file.ok = false;
+        file.step = File::kClose;
+        break;
+      case File::kClose:
+        if (res < 0) file.ok = false;
+        return false;
+    }
+
+    if (file.step == File::kWrite && file.written == file.job.data.size()) {
+      // Empty file: nothing to write.
+      file.step = sync ? File::kSync : File::kClose;
+    }
+    switch (file.step) {
+      case File::kWrite:
+        io_uring_prep_write(Sqe(&file), file.fd,
+                            file.job.data.data() + file.written,
+                            file.job.data.size() - file.written,
+                            file.written);
+        break;
+      case File::kSync:
+        file.sync_start = Clock::now();
+        io_uring_prep_fsync(Sqe(&file), file.fd, 0);
+        break;
+      default:
+        io_uring_prep_close(Sqe(&file), file.fd);
+        break;
+    }
+    return true;
+  }
+
+  io_uring ring;
+  int init_result;
+  BoundedQueue<Job> jobs;
+  std::thread thread;
+};
+#endif
+
+}  // namespace
+
+void AsyncFileWriter::Write(std::string file_name, std::string data) {
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    if (!started) {
+      started = true;
+      first_write = Clock::now();
+    }
+  }
+  Queue({std::move(file_name), std::move(data)});
+}
+
+void AsyncFileWriter::Done(const Job& job, bool ok, double fsync_time) {
+  if (!ok) {
+    std::cerr << "Could not write '" << job.file_name << "'" << std::endl;
+  }
+  std::lock_guard<std::mutex> lock(stats_mutex);
+  last_done = Clock::now();
+  if (!ok) {
+    errors++;
+    return;
+  }
+  files++;
+  bytes += job.data.size();
+  fsync_seconds += fsync_time;
+  max_fsync_seconds = std::max(max_fsync_seconds, fsync_time);
+}
+
+void AsyncFileWriter::Report(std::ostream& out) const {
+  std::lock_guard<std::mutex> lock(stats_mutex);
+  if (files + errors == 0) return;
+  double seconds =
+      std::chrono::duration<double>(last_done - first_write).count();
+  double megabytes = bytes / (1024.0 * 1024.0);
+  out << "Wrote " << files << " files, " << megabytes << " MB in " << seconds
+      << " s (" << (seconds > 0 ? megabytes / seconds : 0) << " MB/s) with "
+      << name() << ", up to " << max_in_flight << " files in flight."
+      << std::endl;
+  if (sync) {
+    out << "fsync: " << fsync_seconds << " s in total, "
+        << (files ? fsync_seconds * 1000 / files : 0) << " ms average, "
+        << max_fsync_seconds * 1000 << " ms max." << std::endl;
+  } else {
+    out << "fsync: off, data may still be in the page cache." << std::endl;
+  }
+  if (errors > 0) {
+    out << errors << " files could not be written." << std::endl;
+  }
+}
+
+size_t AsyncFileWriter::failed_files() const {
+  std::lock_guard<std::mutex> lock(stats_mutex);
+  return errors;
+}
+
+bool parse_io_backend(const std::string& name, IoBackend& backend) {
+  if (name == "auto") {
+    backend = IoBackend::kAuto;
+  } else if (name == "io_uring") {
+    backend = IoBackend::kIoUring;
+  } else if (name == "threads") {
+    backend = IoBackend::kThreads;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+std::unique_ptr<AsyncFileWriter> make_async_file_writer(IoBackend backend,
+                                                        size_t max_in_flight,
+                                                        bool sync) {
+  if (backend != IoBackend::kThreads) {
+#if defined(HAVE_LIBURING)
+    auto writer = std::make_unique<IoUringFileWriter>(max_in_flight, sync);
+    if (writer->ok()) return writer;
+    if (backend == IoBackend::kIoUring) {
+      std::cerr << "io_uring is not available (" << strerror(writer->error())
+                << "), writing on threads instead." << std::endl;
+    }
+#else
+    if (backend == IoBackend::kIoUring) {
+      std::cerr << "Built without liburing, writing on threads instead."
+                << std::endl;
+    }
+#endif
+  }
+  return std::make_unique<ThreadsFileWriter>(max_in_flight, sync);
+}
@@ -0,0 +1,79 @@
+#ifndef TRAININGDATA_TOOL_ASYNCFILEWRITER_H
+#define TRAININGDATA_TOOL_ASYNCFILEWRITER_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+// Writes whole files in the background, so that the threads encoding shards
+// do not stall on the device. Up to max_in_flight files are queued or being
+// written at once; Write() blocks beyond that.
+//
+// The io_uring backend creates, writes, optionally fsyncs and closes files
+// from a single thread, submitting the steps of every file in flight in one
+// batch. The threads backend does the same with blocking calls, with one
+// thread per file in flight.
+class AsyncFileWriter {
+ public:
+  virtual ~AsyncFileWriter() = default;
+
+  virtual const char* name() const = 0;
+
+  // Queues data to be written to file_name, replacing any existing file.
+  void Write(std::string file_name, std::string data);
+
+  // Waits until every queued file is written and closed. No file may be
+  // queued afterwards.
+  virtual void Finish() = 0;
+
+  // Prints the files and bytes written, the throughput and the time spent in
+  // fsync. Prints nothing if no file was queued.
+  void Report(std::ostream& out) const;
+
+  // Files that could not be written.
+  size_t failed_files() const;
+
+ protected:
+  AsyncFileWriter(size_t max_in_flight, bool sync)
+      : max_in_flight(max_in_flight ? max_in_flight : 1), sync(sync) {}
+
+  struct Job {
+    std::string file_name;
+    std::string data;
+  };
+
+  virtual void Queue(Job job) = 0;
+  // Called by the backends once a file is closed.
+  void Done(const Job& job, bool ok, double fsync_seconds);
+
+  const size_t max_in_flight;
+  const bool sync;
+
+ private:
+  mutable std::mutex stats_mutex;
+  bool started = false;
+  std::chrono::steady_clock::time_point first_write;
+  std::chrono::steady_clock::time_point last_done;
+  size_t files = 0;
+  size_t errors = 0;
+  uint64_t bytes = 0;
+  double fsync_seconds = 0;
+  double max_fsync_seconds = 0;
+};
+
+enum class IoBackend { kAuto, kIoUring, kThreads };
+
+// "auto", "io_uring" or "threads".
+bool parse_io_backend(const std::string& name, IoBackend& backend);
+
+// io_uring is used if it was built in and the kernel allows it; kAuto falls
+// back to threads silently and kIoUring with a warning. With sync, every
+// file is fsynced before it is closed.
+std::unique_ptr<AsyncFileWriter> make_async_file_writer(IoBackend backend,
+                                                        size_t max_in_flight,
+                                                        bool sync);
+
+#endif
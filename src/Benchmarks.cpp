@@ -0,0 +1,330 @@
+#include "Benchmarks.h"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#include "ChunkCodec.h"
+#include "CompressionPool.h"
+#include "GameSource.h"
+#include "HistoryEncoder.h"
+#include "PolicyIndex.h"
+#include "SanMove.h"
+#include "TrainingDataWriter.h"
+#include "trainingdata.h"
+#include "neural/encoder.h"
+#include "utils/bititer.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// A game replayed on the lc0 board, up to its first unreadable move.
+struct ReplayedGame {
+  lczero::ChessBoard start;
+  std::vector<lczero::Move> moves;
+};
+
+// The first games of the file, up to about max_positions positions.
+std::vector<ReplayedGame> replay_games(const std::string& pgn_file_name,
+                                       size_t max_positions) {
+  std::vector<ReplayedGame> games;
+  auto source = open_game_source(pgn_file_name, 0, true, false);
+  SanBuffer san;
+  size_t positions = 0;
+  while (positions < max_positions) {
+    auto game = source->NextGame();
+    if (!game) break;
+    ReplayedGame& replayed = games.emplace_back();
+    replayed.start.SetFromFen(game->getFen().empty()
+                                  ? lczero::ChessBoard::kStartposFen
+                                  : game->getFen());
+    lczero::ChessBoard board = replayed.start;
+    for (size_t i = 0; i < game->moves.size(); ++i) {
+      lczero::Move move;
+      if (!normalize_san(game->getMove(i), san) ||
+          !resolve_san(san.view(), board, board.GenerateLegalMoves(),
+                       board.flipped(), move)) {
+        break;
+      }
+      replayed.moves.push_back(move);
+      board.ApplyMove(move);
+      board.Mirror();
+    }
+    positions += replayed.moves.size();
+  }
+  return games;
+}
+
+// VectorChunkSink that counts the records moved when the vector grows.
+class CountingVectorSink : public VectorChunkSink {
+ public:
+  lczero::V6TrainingData& Append() override {
+    if (chunks.size() == chunks.capacity()) moved += chunks.size();
+    return VectorChunkSink::Append();
+  }
+  size_t moved = 0;
+};
+
+}  // namespace
+
+void benchmark_pgn_readers(const std::string& pgn_file_name) {
+  const double megabytes =
+      std::filesystem::file_size(pgn_file_name) / (1024.0 * 1024.0);
+  std::cout << "Benchmarking PGN readers on '" << pgn_file_name << "' ("
+            << megabytes << " MB)" << std::endl;
+  for (bool fast_lexer : {false, true}) {
+    auto start = Clock::now();
+    auto source = open_game_source(pgn_file_name, 0, fast_lexer, true);
+    size_t games = 0;
+    size_t moves = 0;
+    size_t game_bytes = 0;
+    while (auto game = source->NextGame()) {
+      games++;
+      moves += game->moves.size();
+      game_bytes += game->getMemoryUsage();
+    }
+    double elapsed = seconds_since(start);
+    std::cout << (fast_lexer ? "lexer:    " : "polyglot: ") << games
+              << " games, " << moves << " moves in " << elapsed << " s, "
+              << megabytes / elapsed << " MB/s, " << games / elapsed
+              << " games/s, " << (games ? game_bytes / games : 0)
+              << " bytes/game" << std::endl;
+  }
+}
+
+bool benchmark_policy_index(const std::string& pgn_file_name) {
+  const size_t kRounds = 10;
+  std::vector<lczero::MoveList> positions;
+  for (const auto& game : replay_games(pgn_file_name, 1000000)) {
+    lczero::ChessBoard board = game.start;
+    for (lczero::Move move : game.moves) {
+      positions.push_back(board.GenerateLegalMoves());
+      board.ApplyMove(move);
+      board.Mirror();
+    }
+  }
+  size_t mismatches = 0;
+  for (const auto& legal_moves : positions) {
+    for (lczero::Move move : legal_moves) {
+      for (int transform = 0; transform < 8; ++transform) {
+        if (policy_index(move, transform) ==
+            lczero::MoveToNNIndex(move, transform)) {
+          continue;
+        }
+        if (mismatches++ < 10) {
+          std::cerr << "Policy index " << policy_index(move, transform)
+                    << " of move " << move.ToString(false)
+                    << " under transform " << transform
+                    << " differs from MoveToNNIndex "
+                    << lczero::MoveToNNIndex(move, transform) << std::endl;
+        }
+      }
+    }
+  }
+  if (mismatches > 0) {
+    std::cerr << mismatches << " policy indices differ from MoveToNNIndex."
+              << std::endl;
+    return false;
+  }
+  std::cout << "Policy indices match MoveToNNIndex under all transforms."
+            << std::endl;
+
+  std::cout << "Benchmarking policy masks on " << positions.size()
+            << " positions from '" << pgn_file_name << "'" << std::endl;
+  float probabilities[kPolicySize];
+  for (bool table : {false, true}) {
+    double checksum = 0;
+    auto start = Clock::now();
+    for (size_t round = 0; round < kRounds; ++round) {
+      for (const auto& legal_moves : positions) {
+        if (table) {
+          fill_policy_mask(legal_moves, probabilities);
+        } else {
+          for (auto& probability : probabilities) probability = -1.0f;
+          for (lczero::Move move : legal_moves) {
+            uint16_t idx = lczero::MoveToNNIndex(move, 0);
+            if (idx < kPolicySize) probabilities[idx] = 0.0f;
+          }
+        }
+        checksum += probabilities[positions.size() % kPolicySize];
+      }
+    }
+    double elapsed = seconds_since(start);
+    std::cout << (table ? "table:         " : "MoveToNNIndex: ")
+              << elapsed * 1e9 / (kRounds * positions.size())
+              << " ns/position (checksum " << checksum << ")" << std::endl;
+  }
+  return true;
+}
+
+void benchmark_history_encoder(const std::string& pgn_file_name) {
+  auto games = replay_games(pgn_file_name, 1000000);
+  size_t positions = 0;
+  for (const auto& game : games) positions += game.moves.size();
+  std::cout << "Benchmarking history planes on " << positions
+            << " positions from '" << pgn_file_name << "'" << std::endl;
+  uint64_t planes[HistoryEncoder::kHistory * HistoryEncoder::kPlanesPerBoard];
+  for (bool incremental : {false, true}) {
+    uint64_t checksum = 0;
+    auto start = Clock::now();
+    for (const auto& game : games) {
+      lczero::PositionHistory history;
+      history.Reset(game.start, 0, 0);
+      HistoryEncoder encoder;
+      for (lczero::Move move : game.moves) {
+        if (incremental) {
+          encoder.Encode(history, planes);
+        } else {
+          int transform = 0;
+          lczero::InputPlanes input = lczero::EncodePositionForNN(
+              pblczero::NetworkFormat::INPUT_CLASSICAL_112_PLANE, history,
+              HistoryEncoder::kHistory, lczero::FillEmptyHistory::FEN_ONLY,
+              &transform);
+          for (size_t i = 0; i < std::size(planes); ++i) {
+            planes[i] = lczero::ReverseBitsInBytes(input[i].mask);
+          }
+        }
+        checksum ^= planes[positions % std::size(planes)];
+        history.Append(move);
+      }
+    }
+    double elapsed = seconds_since(start);
+    std::cout << (incremental ? "incremental:         "
+                              : "EncodePositionForNN: ")
+              << elapsed * 1e9 / positions << " ns/position (checksum "
+              << checksum << ")" << std::endl;
+  }
+}
+
+void benchmark_chunk_sinks(const std::string& pgn_file_name, Options options) {
+  const size_t kMaxGames = 10000;
+  std::vector<PGNGame> games;
+  auto source = open_game_source(pgn_file_name, 0, true,
+                                 options.keepComments());
+  while (games.size() < kMaxGames) {
+    auto game = source->NextGame();
+    if (!game) break;
+    games.push_back(std::move(*game));
+  }
+  std::cout << "Benchmarking chunk sinks on " << games.size()
+            << " games from '" << pgn_file_name << "'" << std::endl;
+  const size_t record_size = sizeof(lczero::V6TrainingData);
+
+  size_t vector_positions = 0;
+  {
+    size_t positions = 0;
+    size_t copied = 0;
+    size_t peak = 0;
+    uint64_t checksum = 0;
+    auto start = Clock::now();
+    for (const auto& game : games) {
+      CountingVectorSink sink;
+      game.getChunks(options, sink);
+      for (const auto& chunk : sink.chunks) checksum += chunk.visits;
+      positions += sink.chunks.size();
+      // Each record is copied from the template, plus the moves on growth.
+      copied += (sink.chunks.size() + sink.moved) * record_size;
+      peak = std::max(peak, sink.chunks.capacity() * record_size);
+    }
+    double elapsed = seconds_since(start);
+    if (positions == 0) return;
+    std::cout << "vector: " << positions << " positions, "
+              << elapsed * 1e9 / positions << " ns/position, "
+              << copied / positions << " bytes copied/position, " << peak
+              << " bytes peak record memory (checksum " << checksum << ")"
+              << std::endl;
+    vector_positions = positions;
+  }
+
+  // The writer of the single threaded pipeline, writing raw shards of
+  // chunks_per_file records to a temporary directory on one pool thread.
+  const std::string dir_prefix =
+      (std::filesystem::temp_directory_path() /
+       "trainingdata-tool-benchmark-")
+          .string();
+  const size_t kChunksPerFile = 4096;
+  size_t copied = 0;
+  auto start = Clock::now();
+  {
+    CompressionPool pool(1, *codec_by_name("raw"), -1);
+    TrainingDataWriter writer(SIZE_MAX, kChunksPerFile, 0, dir_prefix,
+                              nullptr, &pool);
+    for (const auto& game : games) game.getChunks(options, writer);
+    writer.Finalize();
+    pool.Finish();
+    // Each record is copied from the template into the shard, plus the
+    // records moved when a shard outgrows its buffer.
+    copied = vector_positions * record_size + writer.bytes_moved();
+  }
+  double elapsed = seconds_since(start);
+  std::filesystem::remove_all(dir_prefix + "0");
+  std::cout << "writer: " << vector_positions << " positions, "
+            << elapsed * 1e9 / vector_positions
+            << " ns/position including the raw shard writes, "
+            << copied / vector_positions << " bytes copied/position, "
+            << kChunksPerFile * record_size
+            << " bytes of shard buffer, plus one shard queued" << std::endl;
+}
+
+void benchmark_output_codecs(const std::string& pgn_file_name, Options options,
+                             int level) {
+  const size_t kMaxGames = 10000;
+  std::string records;
+  auto source = open_game_source(pgn_file_name, 0, true,
+                                 options.keepComments());
+  for (size_t games = 0; games < kMaxGames; ++games) {
+    auto game = source->NextGame();
+    if (!game) break;
+    for (const auto& chunk : game->getChunks(options)) {
+      records.append(reinterpret_cast<const char*>(&chunk), sizeof(chunk));
+    }
+  }
+  const double megabytes = records.size() / (1024.0 * 1024.0);
+  std::cout << "Benchmarking output codecs on "
+            << records.size() / sizeof(lczero::V6TrainingData)
+            << " records (" << megabytes << " MB) from '" << pgn_file_name
+            << "'" << std::endl;
+
+  for (const char* name : {"gzip", "zstd", "raw"}) {
+    const ChunkCodec* codec = codec_by_name(name);
+    if (nullptr == codec) {
+      std::cout << name << ": not supported by this build" << std::endl;
+      continue;
+    }
+    std::string file_name =
+        (std::filesystem::temp_directory_path() /
+         (std::string("trainingdata-tool-benchmark") + codec->extension()))
+            .string();
+    auto start = Clock::now();
+    if (!codec->WriteFile(file_name, records, level)) {
+      std::cout << name << ": could not write '" << file_name << "'"
+                << std::endl;
+      continue;
+    }
+    double encode = seconds_since(start);
+    uint64_t file_size = std::filesystem::file_size(file_name);
+
+    start = Clock::now();
+    std::string decoded(records.size(), '\0');
+    size_t decoded_size = 0;
+    if (auto reader = codec->Open(file_name, 0)) {
+      decoded_size = reader->Read(decoded.data(), decoded.size());
+    }
+    double decode = seconds_since(start);
+    std::filesystem::remove(file_name);
+
+    std::cout << name << ": encode " << megabytes / encode << " MB/s, decode "
+              << megabytes / decode << " MB/s, "
+              << 100.0 * file_size / records.size() << "% of raw size"
+              << (decoded_size == records.size() && decoded == records
+                      ? ""
+                      : ", DECODED DATA DIFFERS")
+              << std::endl;
+  }
+}
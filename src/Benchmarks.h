@@ -0,0 +1,36 @@
+#ifndef TRAININGDATA_TOOL_BENCHMARKS_H
+#define TRAININGDATA_TOOL_BENCHMARKS_H
+
+#include <string>
+
+#include "PGNGame.h"
+
+// Reads every game of the file with the polyglot reader and with PGNLexer
+// and prints the throughput of each in MB/s and games/s, along with the
+// average memory held by one parsed game.
+void benchmark_pgn_readers(const std::string& pgn_file_name);
+
+// Replays the games of the file and times building the policy mask of every
+// position with lczero::MoveToNNIndex and with fill_policy_mask. First checks
+// policy_index against lczero::MoveToNNIndex for every legal move under all
+// 8 transforms, and returns false if they ever differ.
+bool benchmark_policy_index(const std::string& pgn_file_name);
+
+// Replays the games of the file and times encoding the history planes of
+// every position with lczero::EncodePositionForNN and with HistoryEncoder.
+// Both include the cost of appending the moves to a PositionHistory.
+void benchmark_history_encoder(const std::string& pgn_file_name);
+
+// Converts the games of the file into a vector per game, as the threaded
+// pipeline does, and straight into a TrainingDataWriter, and prints the time
+// and bytes copied per position of each, with the record memory they hold.
+// The writer's raw shards go to a temporary directory that is removed.
+void benchmark_chunk_sinks(const std::string& pgn_file_name, Options options);
+
+// Converts the games of the file and times writing the records to a
+// temporary file and reading them back with every ChunkCodec, printing the
+// encode and decode throughput in MB of records per second and the size.
+void benchmark_output_codecs(const std::string& pgn_file_name, Options options,
+                             int level);
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef TRAININGDATA_TOOL_BOUNDEDQUEUE_H
+#define TRAININGDATA_TOOL_BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <utility>
+
+// Blocking multi-producer / multi-consumer FIFO with a fixed capacity.
+// Producers block while the queue is full, consumers block while it is empty.
+// Once Close() is called pushes fail and consumers drain what is left.
+template <typename T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(size_t capacity) : capacity(capacity ? capacity : 1) {}
+
+  // Returns false if the queue was closed before the item could be queued.
+  bool Push(T item) {
+    std::unique_lock<std::mutex> lock(mutex);
+    not_full.wait(lock, [this] { return closed || items.size() < capacity; });
+    if (closed) return false;
+    items.push(std::move(item));
+    not_empty.notify_one();
+    return true;
+  }
+
+  // Returns std::nullopt once the queue is closed and fully drained.
+  std::optional<T> Pop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    not_empty.wait(lock, [this] { return closed || !items.empty(); });
+    if (items.empty()) return std::nullopt;
+    T item = std::move(items.front());
+    items.pop();
+    not_full.notify_one();
+    return item;
+  }
+
+  // Like Pop() but never waits: std::nullopt if the queue is empty.
+  std::optional<T> TryPop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (items.empty()) return std::nullopt;
+    T item = std::move(items.front());
+    items.pop();
+    not_full.notify_one();
+    return item;
+  }
+
+  void Close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    not_full.notify_all();
+    not_empty.notify_all();
+  }
+
+ private:
+  const size_t capacity;
+  bool closed = false;
+  std::queue<T> items;
+  std::mutex mutex;
+  std::condition_variable not_full;
+  std::condition_variable not_empty;
+};
+
+#endif
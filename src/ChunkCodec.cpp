@@ -0,0 +1,322 @@
+#include "ChunkCodec.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#if defined(HAVE_ZSTD)
+#include <zstd.h>
+#endif
+
+#include "MappedFile.h"
+
+namespace {
+
+bool ends_with(std::string_view s, std::string_view suffix) {
+  return s.size() >= suffix.size() &&
+         s.substr(s.size() - suffix.size()) == suffix;
+}
+
+class GzipReader : public ChunkFileReader {
+ public:
+  explicit GzipReader(gzFile file) : file(file) {}
+  ~GzipReader() override { gzclose(file); }
+
+  size_t Read(void* buffer, size_t length) override {
+    int bytes_read = gzread(file, buffer, static_cast<unsigned>(length));
+    return bytes_read > 0 ? bytes_read : 0;
+  }
+
+  // Z_BUF_ERROR is a stream cut short, anything else a corrupt one.
+  bool failed() const override {
+    int error;
+    gzerror(file, &error);
+    return error != Z_OK;
+  }
+
+ private:
+  gzFile file;
+};
+
+// Inflates a gzip stream held in memory.
+class GzipMemoryReader : public ChunkFileReader {
+ public:
+  explicit GzipMemoryReader(std::string_view encoded) {
+    stream.next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(encoded.data()));
+    stream.avail_in = static_cast<uInt>(encoded.size());
+    ok = inflateInit2(&stream, 16 + 15) == Z_OK;
+  }
+  ~GzipMemoryReader() override {
+    if (ok) inflateEnd(&stream);
+  }
+
+  size_t Read(void* buffer, size_t length) override {
+    if (!ok) return 0;
+    stream.next_out = static_cast<Bytef*>(buffer);
+    stream.avail_out = static_cast<uInt>(length);
+    while (stream.avail_out > 0) {
+      int ret = inflate(&stream, Z_NO_FLUSH);
+      if (ret != Z_OK) {
+        ok = false;
+        complete = ret == Z_STREAM_END;
+        break;
+      }
+    }
+    return length - stream.avail_out;
+  }
+
+  bool failed() const override { return !ok && !complete; }
+
+ private:
+  z_stream stream{};
+  bool ok = false;
+  bool complete = false;
+};
+
+class GzipCodec : public ChunkCodec {
+ public:
+  const char* name() const override { return "gzip"; }
+  const char* extension() const override { return ".gz"; }
+
+  bool Encode(std::string_view data, int level,
+              std::string& encoded) const override {
+    z_stream stream{};
+    // 16 + 15: gzip header and trailer around a 32 KB window deflate stream.
+    if (deflateInit2(&stream, level, Z_DEFLATED, 16 + 15, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+      return false;
+    }
+    encoded.resize(deflateBound(&stream, data.size()));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(encoded.data());
+    stream.avail_out = static_cast<uInt>(encoded.size());
+    int ret = deflate(&stream, Z_FINISH);
+    encoded.resize(stream.total_out);
+    deflateEnd(&stream);
+    return ret == Z_STREAM_END;
+  }
+
+  bool ValidLevel(int level) const override {
+    return level == Z_DEFAULT_COMPRESSION ||
+           (level >= Z_NO_COMPRESSION && level <= Z_BEST_COMPRESSION);
+  }
+
+  std::unique_ptr<ChunkFileReader> Open(const std::string& file_name,
+                                        size_t buffer_size) const override {
+    gzFile file = gzopen(file_name.c_str(), "rb");
+    if (nullptr == file) return nullptr;
+    // zlib reads 8 KB at a time by default, one syscall per record.
+    if (buffer_size > 0) gzbuffer(file, static_cast<unsigned>(buffer_size));
+    return std::make_unique<GzipReader>(file);
+  }
+
+  std::unique_ptr<ChunkFileReader> OpenEncoded(
+      std::string_view encoded) const override {
+    return std::make_unique<GzipMemoryReader>(encoded);
+  }
+};
+
+#if defined(HAVE_ZSTD)
+// Decompresses a zstd stream from a file, or from memory if file is nullptr.
+class ZstdReader : public ChunkFileReader {
+ public:
+  ZstdReader(FILE* file, size_t buffer_size)
+      : file(file),
+        stream(ZSTD_createDCtx()),
+        input(std::max(buffer_size, ZSTD_DStreamInSize()), '\0') {}
+  explicit ZstdReader(std::string_view encoded)
+      : file(nullptr),
+        stream(ZSTD_createDCtx()),
+        in{encoded.data(), encoded.size(), 0} {}
+  ~ZstdReader() override {
+    ZSTD_freeDCtx(stream);
+    if (file) fclose(file);
+  }
+
+  size_t Read(void* buffer, size_t length) override {
+    ZSTD_outBuffer output{buffer, length, 0};
+    while (output.pos < output.size && !ZSTD_isError(pending)) {
+      if (in.pos == in.size && file && !end_of_file) {
+        in.size = fread(input.data(), 1, input.size(), file);
+        in.src = input.data();
+        in.pos = 0;
+        end_of_file = in.size == 0;
+      }
+      // 0 once a frame is complete, else a hint of the input still needed.
+      // With all input consumed the decoder may still hold output of the
+      // last block, so keep calling it until it has nothing more to give.
+      // A call without progress past the end of a frame would ask for the
+      // next frame's header, so its result is only kept if it is an error.
+      size_t input_before = in.pos;
+      size_t output_before = output.pos;
+      size_t result = ZSTD_decompressStream(stream, &output, &in);
+      if (in.pos == input_before && output.pos == output_before &&
+          (nullptr == file || end_of_file)) {
+        if (ZSTD_isError(result)) pending = result;
+        break;
+      }
+      pending = result;
+    }
+    return output.pos;
+  }
+
+  bool failed() const override { return pending != 0; }
+
+ private:
+  FILE* file;
+  ZSTD_DCtx* stream;
+  std::string input;
+  ZSTD_inBuffer in{nullptr, 0, 0};
+  bool end_of_file = false;
+  size_t pending = 0;
+};
+
+class ZstdCodec : public ChunkCodec {
+ public:
+  const char* name() const override { return "zstd"; }
+  const char* extension() const override { return ".zst"; }
+
+  bool Encode(std::string_view data, int level,
+              std::string& encoded) const override {
+    encoded.resize(ZSTD_compressBound(data.size()));
+    size_t size = ZSTD_compress(encoded.data(), encoded.size(), data.data(),
+                                data.size(),
+                                level < 0 ? ZSTD_CLEVEL_DEFAULT : level);
+    if (ZSTD_isError(size)) return false;
+    encoded.resize(size);
+    return true;
+  }
+
+  // Negative levels select the default.
+  bool ValidLevel(int level) const override {
+    return level <= ZSTD_maxCLevel();
+  }
+
+  std::unique_ptr<ChunkFileReader> Open(const std::string& file_name,
+                                        size_t buffer_size) const override {
+    FILE* file = fopen(file_name.c_str(), "rb");
+    if (nullptr == file) return nullptr;
+    return std::make_unique<ZstdReader>(file, buffer_size);
+  }
+
+  std::unique_ptr<ChunkFileReader> OpenEncoded(
+      std::string_view encoded) const override {
+    return std::make_unique<ZstdReader>(encoded);
+  }
+};
+#endif
+
+// Copies out of bytes in memory.
+class MemoryReader : public ChunkFileReader {
+ public:
+  explicit MemoryReader(std::string_view data) : data(data) {}
+
+  size_t Read(void* buffer, size_t length) override {
+    std::string_view read = data.substr(0, length);
+    memcpy(buffer, read.data(), read.size());
+    data.remove_prefix(read.size());
+    return read.size();
+  }
+
+ private:
+  std::string_view data;
+};
+
+// Reads a raw file through a memory mapping.
+class RawReader : public ChunkFileReader {
+ public:
+  explicit RawReader(const std::string& file_name)
+      : file(file_name), reader(file.data()) {}
+  bool ok() const { return file.ok(); }
+
+  size_t Read(void* buffer, size_t length) override {
+    return reader.Read(buffer, length);
+  }
+
+ private:
+  MappedFile file;
+  MemoryReader reader;
+};
+
+class RawCodec : public ChunkCodec {
+ public:
+  const char* name() const override { return "raw"; }
+  const char* extension() const override { return ".raw"; }
+
+  bool Encode(std::string_view data, int,
+              std::string& encoded) const override {
+    encoded.assign(data);
+    return true;
+  }
+
+  // There is nothing to compress.
+  bool ValidLevel(int) const override { return true; }
+
+  // Skips the copy into an encoded buffer.
+  bool WriteFile(const std::string& file_name, std::string_view data,
+                 int) const override {
+    return write_file(file_name, data);
+  }
+
+  // Memory mapped, so there is no buffer.
+  std::unique_ptr<ChunkFileReader> Open(const std::string& file_name,
+                                        size_t) const override {
+    auto reader = std::make_unique<RawReader>(file_name);
+    if (!reader->ok()) return nullptr;
+    return reader;
+  }
+
+  std::unique_ptr<ChunkFileReader> OpenEncoded(
+      std::string_view encoded) const override {
+    return std::make_unique<MemoryReader>(encoded);
+  }
+};
+
+const GzipCodec kGzipCodec;
+#if defined(HAVE_ZSTD)
+const ZstdCodec kZstdCodec;
+#endif
+const RawCodec kRawCodec;
+
+const ChunkCodec* const all_codecs[] = {
+    &kGzipCodec,
+#if defined(HAVE_ZSTD)
+    &kZstdCodec,
+#endif
+    &kRawCodec,
+};
+
+}  // namespace
+
+bool ChunkCodec::WriteFile(const std::string& file_name, std::string_view data,
+                           int level) const {
+  std::string encoded;
+  return Encode(data, level, encoded) && write_file(file_name, encoded);
+}
+
+bool write_file(const std::string& file_name, std::string_view data) {
+  FILE* file = fopen(file_name.c_str(), "wb");
+  if (nullptr == file) return false;
+  bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+  return fclose(file) == 0 && ok;
+}
+
+const ChunkCodec& gzip_codec() { return kGzipCodec; }
+
+const ChunkCodec* codec_by_name(std::string_view name) {
+  for (const ChunkCodec* codec : all_codecs) {
+    if (name == codec->name()) return codec;
+  }
+  return nullptr;
+}
+
+const ChunkCodec* codec_for_file(std::string_view file_name) {
+  for (const ChunkCodec* codec : all_codecs) {
+    if (ends_with(file_name, codec->extension())) return codec;
+  }
+  return nullptr;
+}
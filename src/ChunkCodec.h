@@ -0,0 +1,71 @@
+#ifndef TRAININGDATA_TOOL_CHUNKCODEC_H
+#define TRAININGDATA_TOOL_CHUNKCODEC_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Sequential reader of the decoded bytes of one training data file.
+class ChunkFileReader {
+ public:
+  virtual ~ChunkFileReader() = default;
+  // Reads up to length bytes. Returns how many were read, which is less than
+  // length only at the end of the file or on an error.
+  virtual size_t Read(void* buffer, size_t length) = 0;
+
+  // True once a read stopped at an error rather than at the end of the data,
+  // e.g. in a truncated compressed stream.
+  virtual bool failed() const { return false; }
+};
+
+// File format of training data shards.
+//
+// gzip is what lc0's training pipeline reads. zstd decodes several times
+// faster, and raw files are the V6 records as they are in memory, which can
+// be memory mapped as an array.
+class ChunkCodec {
+ public:
+  virtual ~ChunkCodec() = default;
+
+  virtual const char* name() const = 0;
+  // File name extension, including the dot.
+  virtual const char* extension() const = 0;
+
+  // Encodes data into encoded. level is codec specific; -1 selects the
+  // codec's default. Returns false on an encoder error.
+  virtual bool Encode(std::string_view data, int level,
+                      std::string& encoded) const = 0;
+
+  // Whether Encode() accepts level.
+  virtual bool ValidLevel(int level) const = 0;
+
+  // Encodes data and writes it to file_name. Returns false if the file could
+  // not be written.
+  virtual bool WriteFile(const std::string& file_name, std::string_view data,
+                         int level) const;
+
+  // Returns nullptr if the file cannot be opened. buffer_size is the size of
+  // the reader's input buffer; 0 keeps the codec's default.
+  virtual std::unique_ptr<ChunkFileReader> Open(const std::string& file_name,
+                                                size_t buffer_size) const = 0;
+
+  // Decodes a file that is already in memory, e.g. a member of a pack. The
+  // encoded bytes must outlive the reader.
+  virtual std::unique_ptr<ChunkFileReader> OpenEncoded(
+      std::string_view encoded) const = 0;
+};
+
+// The codec called name ("gzip", "zstd" or "raw"), or nullptr if it is
+// unknown or not supported by this build.
+const ChunkCodec* codec_by_name(std::string_view name);
+
+// The codec for a file, from its extension, or nullptr.
+const ChunkCodec* codec_for_file(std::string_view file_name);
+
+const ChunkCodec& gzip_codec();
+
+// Writes data to file_name as it is.
+bool write_file(const std::string& file_name, std::string_view data);
+
+#endif
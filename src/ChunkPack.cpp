@@ -0,0 +1,203 @@
+#include "ChunkPack.h"
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include "TrainingDataWriter.h"
+
+namespace {
+
+constexpr char kPackMagic[8] = {'T', 'D', 'P', 'A', 'C', 'K', '0', '2'};
+constexpr size_t kHeaderSize = 16;
+
+struct PackFooter {
+  uint64_t index_offset;
+  uint64_t count;
+  char magic[8];
+};
+static_assert(sizeof(PackFooter) == 24, "PackFooter is stored as it is");
+
+// Reads the members of a pack one after the other.
+class PackFileReader : public ChunkFileReader {
+ public:
+  explicit PackFileReader(std::unique_ptr<ChunkPackReader> pack)
+      : pack(std::move(pack)) {}
+
+  size_t Read(void* buffer, size_t length) override {
+    char* out = static_cast<char*>(buffer);
+    size_t bytes_read = 0;
+    while (bytes_read < length) {
+      if (nullptr == member) {
+        if (next_entry == pack->entries().size()) break;
+        member = pack->OpenMember(pack->entries()[next_entry++]);
+        continue;
+      }
+      size_t n = member->Read(out + bytes_read, length - bytes_read);
+      bytes_read += n;
+      if (bytes_read < length) {
+        if (member->failed()) member_failed = true;
+        member.reset();
+      }
+    }
+    return bytes_read;
+  }
+
+  bool failed() const override { return member_failed; }
+
+ private:
+  std::unique_ptr<ChunkPackReader> pack;
+  size_t next_entry = 0;
+  std::unique_ptr<ChunkFileReader> member;
+  bool member_failed = false;
+};
+
+}  // namespace
+
+ChunkPackWriter::ChunkPackWriter(const std::string& file_name,
+                                 const ChunkCodec& codec)
+    : file_name(file_name), member_codec(codec) {
+  char header[kHeaderSize] = {};
+  memcpy(header, kPackMagic, sizeof(kPackMagic));
+  strncpy(header + sizeof(kPackMagic), codec.name(), sizeof(kPackMagic));
+  file = fopen(file_name.c_str(), "wb");
+  if (file && fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+    fclose(file);
+    file = nullptr;
+  }
+  if (nullptr == file) {
+    std::cerr << "Could not write '" << file_name << "'" << std::endl;
+  }
+  offset = sizeof(header);
+}
+
+ChunkPackWriter::~ChunkPackWriter() { Finish(); }
+
+bool ChunkPackWriter::Finish() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (nullptr == file) return false;
+  PackFooter footer{offset, entries.size(), {}};
+  memcpy(footer.magic, kPackMagic, sizeof(kPackMagic));
+  size_t index_size = entries.size() * sizeof(PackEntry);
+  bool ok = fwrite(entries.data(), 1, index_size, file) == index_size &&
+            fwrite(&footer, 1, sizeof(footer), file) == sizeof(footer);
+  if (fclose(file) != 0 || !ok) {
+    std::cerr << "Could not write the index of '" << file_name << "'"
+              << std::endl;
+    ok = false;
+  }
+  file = nullptr;
+  return ok;
+}
+
+void ChunkPackWriter::Add(std::string_view encoded, uint32_t input,
+                          uint64_t first_game, uint32_t games,
+                          uint32_t records) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (nullptr == file) return;
+  if (fwrite(encoded.data(), 1, encoded.size(), file) != encoded.size()) {
+    std::cerr << "Could not write to '" << file_name << "'" << std::endl;
+    fclose(file);
+    file = nullptr;
+    return;
+  }
+  entries.push_back(
+      {offset, encoded.size(), first_game, input, games, records, 0});
+  offset += encoded.size();
+}
+
+ChunkPackReader::ChunkPackReader(const std::string& file_name)
+    : file(file_name) {
+  std::string_view data = file.data();
+  if (!file.ok() || data.size() < kHeaderSize + sizeof(PackFooter) ||
+      memcmp(data.data(), kPackMagic, sizeof(kPackMagic)) != 0) {
+    return;
+  }
+  PackFooter footer;
+  memcpy(&footer, data.data() + data.size() - sizeof(footer), sizeof(footer));
+  if (memcmp(footer.magic, kPackMagic, sizeof(kPackMagic)) != 0 ||
+      footer.index_offset < kHeaderSize ||
+      footer.index_offset > data.size() - sizeof(footer) ||
+      (data.size() - sizeof(footer) - footer.index_offset) !=
+          footer.count * sizeof(PackEntry)) {
+    return;
+  }
+  index.resize(footer.count);
+  memcpy(index.data(), data.data() + footer.index_offset,
+         footer.count * sizeof(PackEntry));
+  for (const auto& entry : index) {
+    if (entry.offset < kHeaderSize || entry.offset > footer.index_offset ||
+        entry.length > footer.index_offset - entry.offset) {
+      index.clear();
+      return;
+    }
+  }
+  std::string codec_name(data.substr(sizeof(kPackMagic), sizeof(kPackMagic)));
+  pack_codec = codec_by_name(codec_name.c_str());
+}
+
+std::string_view ChunkPackReader::member(const PackEntry& entry) const {
+  return file.data().substr(entry.offset, entry.length);
+}
+
+std::unique_ptr<ChunkFileReader> ChunkPackReader::OpenMember(
+    const PackEntry& entry) const {
+  return pack_codec->OpenEncoded(member(entry));
+}
+
+bool is_pack_file(std::string_view file_name) {
+  std::string_view extension = kPackExtension;
+  return file_name.size() >= extension.size() &&
+         file_name.substr(file_name.size() - extension.size()) == extension;
+}
+
+std::unique_ptr<ChunkFileReader> open_pack(const std::string& file_name) {
+  auto pack = std::make_unique<ChunkPackReader>(file_name);
+  if (!pack->ok()) return nullptr;
+  return std::make_unique<PackFileReader>(std::move(pack));
+}
+
+bool extract_pack(const std::string& file_name, const std::string& dir_prefix,
+                  size_t max_files_per_directory, size_t& files_written) {
+  files_written = 0;
+  ChunkPackReader pack(file_name);
+  if (!pack.ok()) {
+    std::cerr << "'" << file_name << "' is not a complete pack" << std::endl;
+    return false;
+  }
+  const bool copy = &pack.codec() == &gzip_codec();
+  std::string decoded;
+  for (const auto& entry : pack.entries()) {
+    size_t directory_id = files_written / max_files_per_directory;
+    if (files_written % max_files_per_directory == 0) {
+      std::filesystem::create_directories(dir_prefix +
+                                          std::to_string(directory_id));
+    }
+    std::string out_name = shard_file_name(dir_prefix, directory_id,
+                                           files_written,
+                                           gzip_codec().extension());
+    bool ok;
+    if (copy) {
+      ok = write_file(out_name, pack.member(entry));
+    } else {
+      auto member = pack.OpenMember(entry);
+      decoded.clear();
+      char buffer[1 << 16];
+      while (size_t n = member->Read(buffer, sizeof(buffer))) {
+        decoded.append(buffer, n);
+      }
+      if (member->failed()) {
+        std::cerr << "Member " << files_written << " of '" << file_name
+                  << "' is truncated or corrupt" << std::endl;
+        return false;
+      }
+      ok = gzip_codec().WriteFile(out_name, decoded, -1);
+    }
+    if (!ok) {
+      std::cerr << "Could not write '" << out_name << "'" << std::endl;
+      return false;
+    }
+    files_written++;
+  }
+  return true;
+}
@@ -0,0 +1,106 @@
+#ifndef TRAININGDATA_TOOL_CHUNKPACK_H
+#define TRAININGDATA_TOOL_CHUNKPACK_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ChunkCodec.h"
+#include "MappedFile.h"
+
+// A pack holds many encoded shards, the members, in one file so that a
+// conversion does not leave millions of small files behind:
+//
+//   header:  "TDPACK02", codec name padded with zeros to 8 bytes
+//   members: each exactly the bytes the codec would write to its own file
+//   index:   one PackEntry per member, in file order
+//   footer:  index offset, member count, "TDPACK02"
+//
+// The index is only written when the pack is finished, so a pack from an
+// interrupted run cannot be read.
+struct PackEntry {
+  uint64_t offset;
+  uint64_t length;
+  // The member's first game is game first_game of PGN file input: inputs
+  // are numbered in command line order from 0, and games count every game
+  // of the file from 0, filtered ones included, as -start-game and the
+  // .pgnidx index do. Both mean nothing when games is 0.
+  uint64_t first_game;
+  uint32_t input;
+  // 0 for shards of shuffled or deduplicated records.
+  uint32_t games;
+  uint32_t records;
+  uint32_t reserved;
+};
+static_assert(sizeof(PackEntry) == 40, "PackEntry is stored as it is");
+
+constexpr const char* kPackExtension = ".tdpack";
+
+// Appends members to a pack. Add() may be called from several threads;
+// members are stored in the order they are added.
+class ChunkPackWriter {
+ public:
+  ChunkPackWriter(const std::string& file_name, const ChunkCodec& codec);
+  // Finishes the pack if Finish() was not called.
+  ~ChunkPackWriter();
+
+  ChunkPackWriter(const ChunkPackWriter&) = delete;
+  ChunkPackWriter& operator=(const ChunkPackWriter&) = delete;
+
+  bool ok() const { return file != nullptr; }
+  const ChunkCodec& codec() const { return member_codec; }
+
+  // Adds one member, already encoded with codec().
+  void Add(std::string_view encoded, uint32_t input, uint64_t first_game,
+           uint32_t games, uint32_t records);
+
+  // Writes the index and the footer and closes the file. Returns false if
+  // any member or the index could not be written.
+  bool Finish();
+
+ private:
+  const std::string file_name;
+  const ChunkCodec& member_codec;
+  FILE* file = nullptr;
+  std::mutex mutex;
+  uint64_t offset = 0;
+  std::vector<PackEntry> entries;
+};
+
+// Memory maps a pack and reads its index.
+class ChunkPackReader {
+ public:
+  explicit ChunkPackReader(const std::string& file_name);
+
+  // False if the file is not a complete pack or its codec is not supported
+  // by this build.
+  bool ok() const { return pack_codec != nullptr; }
+  const ChunkCodec& codec() const { return *pack_codec; }
+
+  const std::vector<PackEntry>& entries() const { return index; }
+  std::string_view member(const PackEntry& entry) const;
+  std::unique_ptr<ChunkFileReader> OpenMember(const PackEntry& entry) const;
+
+ private:
+  MappedFile file;
+  const ChunkCodec* pack_codec = nullptr;
+  std::vector<PackEntry> index;
+};
+
+bool is_pack_file(std::string_view file_name);
+
+// Reads the records of every member of a pack in turn, or returns nullptr if
+// the pack cannot be read.
+std::unique_ptr<ChunkFileReader> open_pack(const std::string& file_name);
+
+// Writes every member of a pack to its own .gz file, named and laid out in
+// directories as TrainingDataWriter does, and counts them in files_written.
+// gzip members are copied as they are; others are decoded and gzipped.
+// Stops and returns false at a member that cannot be decoded or written.
+bool extract_pack(const std::string& file_name, const std::string& dir_prefix,
+                  size_t max_files_per_directory, size_t& files_written);
+
+#endif
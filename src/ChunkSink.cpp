@@ -0,0 +1,7 @@
+#include "ChunkSink.h"
+
+#include "trainingdata.h"
+
+lczero::V6TrainingData& VectorChunkSink::Append() {
+  return chunks.emplace_back(v6_template_record());
+}
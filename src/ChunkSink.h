@@ -0,0 +1,33 @@
+#ifndef TRAININGDATA_TOOL_CHUNKSINK_H
+#define TRAININGDATA_TOOL_CHUNKSINK_H
+
+#include <vector>
+
+#include "trainingdata/trainingdata_v6.h"
+
+// Receives the training records of a game as they are produced.
+//
+// Append() hands out a record that is already initialized from
+// v6_template_record(), so the producer only writes the fields of its
+// position, directly into the sink's buffer.
+class ChunkSink {
+ public:
+  virtual ~ChunkSink() = default;
+
+  // Returns the next record to fill in. It stays valid until the next call
+  // to Append() or EndGame().
+  virtual lczero::V6TrainingData& Append() = 0;
+
+  // Called after the last record of a game.
+  virtual void EndGame() {}
+};
+
+// Collects records in memory, e.g. for games converted ahead of the writer.
+class VectorChunkSink : public ChunkSink {
+ public:
+  lczero::V6TrainingData& Append() override;
+
+  std::vector<lczero::V6TrainingData> chunks;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#include "CompressionPool.h"
+
+#include <iostream>
+
+CompressionPool::CompressionPool(size_t num_threads, const ChunkCodec& codec,
+                                 int level, ChunkPackWriter* pack,
+                                 AsyncFileWriter* file_writer)
+    : output_codec(codec),
+      level(level),
+      pack(pack),
+      file_writer(file_writer),
+      jobs(2 * (num_threads ? num_threads : 1)) {
+  for (size_t i = 0; i < (num_threads ? num_threads : 1); ++i) {
+    threads.emplace_back([this] { Run(); });
+  }
+}
+
+CompressionPool::~CompressionPool() { Finish(); }
+
+void CompressionPool::Finish() {
+  jobs.Close();
+  for (auto& thread : threads) thread.join();
+  threads.clear();
+}
+
+void CompressionPool::Submit(Shard shard) {
+  std::lock_guard<std::mutex> lock(submit_mutex);
+  jobs.Push({next_sequence++, std::move(shard)});
+}
+
+void CompressionPool::Run() {
+  std::string encoded;
+  while (auto queued = jobs.Pop()) {
+    Shard* job = &queued->shard;
+    if (pack) {
+      bool ok = output_codec.Encode(job->data, level, encoded);
+      AddToPack(*queued, ok ? &encoded : nullptr);
+    } else if (file_writer) {
+      // Moved to the writer, so every shard gets a new buffer.
+      std::string shard_file;
+      if (output_codec.Encode(job->data, level, shard_file)) {
+        file_writer->Write(std::move(job->file_name), std::move(shard_file));
+      } else {
+        std::cerr << "Could not encode '" << job->file_name << "'"
+                  << std::endl;
+        failures++;
+      }
+    } else if (!output_codec.WriteFile(job->file_name, job->data, level)) {
+      std::cerr << "Could not write '" << job->file_name << "'" << std::endl;
+      failures++;
+    }
+  }
+}
+
+// Waits for the turn of job, so that members are added in sequence order.
+// encoded is nullptr if the shard could not be encoded.
+void CompressionPool::AddToPack(const Job& job, const std::string* encoded) {
+  std::unique_lock<std::mutex> lock(pack_mutex);
+  pack_turn.wait(lock, [&] { return next_member == job.sequence; });
+  if (encoded) {
+    pack->Add(*encoded, job.shard.input, job.shard.first_game,
+              job.shard.games, job.shard.records);
+  } else {
+    std::cerr << "Could not encode a shard" << std::endl;
+    failures++;
+  }
+  next_member++;
+  pack_turn.notify_all();
+}
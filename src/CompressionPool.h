@@ -0,0 +1,91 @@
+#ifndef TRAININGDATA_TOOL_COMPRESSIONPOOL_H
+#define TRAININGDATA_TOOL_COMPRESSIONPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AsyncFileWriter.h"
+#include "BoundedQueue.h"
+#include "ChunkCodec.h"
+#include "ChunkPack.h"
+
+// Encodes whole output shards with a ChunkCodec on worker threads, so that
+// the threads producing training data do not wait for compression.
+//
+// At most two shards per worker wait in the queue; Submit() blocks beyond
+// that, which bounds the memory held by uncompressed shards.
+//
+// With a pack, encoded shards are added to it as members instead of being
+// written to their own files, in the order they were submitted whichever
+// worker finishes first, so a pack only depends on the order of Submit()
+// calls. Otherwise they are handed to the
+// AsyncFileWriter if there is one, or written by the worker.
+class CompressionPool {
+ public:
+  struct Shard {
+    // Unused with a pack.
+    std::string file_name;
+    // Uncompressed records.
+    std::string data;
+    // For the pack index.
+    uint32_t input = 0;
+    uint64_t first_game = 0;
+    uint32_t games = 0;
+    uint32_t records = 0;
+  };
+
+  // level is passed to the codec; -1 is the codec's default. pack, if not
+  // nullptr, must use the same codec. pack and file_writer must outlive the
+  // pool.
+  CompressionPool(size_t num_threads, const ChunkCodec& codec, int level,
+                  ChunkPackWriter* pack = nullptr,
+                  AsyncFileWriter* file_writer = nullptr);
+  ~CompressionPool();
+
+  // Encodes every submitted shard and hands it on. No shard may be submitted
+  // afterwards.
+  void Finish();
+
+  CompressionPool(const CompressionPool&) = delete;
+  CompressionPool& operator=(const CompressionPool&) = delete;
+
+  void Submit(Shard shard);
+
+  const ChunkCodec& codec() const { return output_codec; }
+  bool packing() const { return pack != nullptr; }
+
+  // Shards that could not be encoded or written by the pool itself. Files
+  // handed to the AsyncFileWriter are counted there.
+  size_t failed_shards() const { return failures; }
+
+ private:
+  struct Job {
+    uint64_t sequence;
+    Shard shard;
+  };
+
+  void Run();
+  void AddToPack(const Job& job, const std::string* encoded);
+
+  const ChunkCodec& output_codec;
+  const int level;
+  ChunkPackWriter* pack;
+  AsyncFileWriter* file_writer;
+  // Jobs are queued in sequence order, so the worker holding the next
+  // member to add is never waiting for a turn.
+  BoundedQueue<Job> jobs;
+  std::mutex submit_mutex;
+  uint64_t next_sequence = 0;
+  std::mutex pack_mutex;
+  std::condition_variable pack_turn;
+  uint64_t next_member = 0;
+  std::atomic<size_t> failures = 0;
+  std::vector<std::thread> threads;
+};
+
+#endif
@@ -0,0 +1,92 @@
+#include "ConversionPipeline.h"
+
+#include <iostream>
+#include <thread>
+
+ConversionPipeline::ConversionPipeline(Options options, size_t num_threads,
+                                       SplitWriters& writers)
+    : options(options),
+      num_threads(num_threads ? num_threads : 1),
+      writers(writers),
+      jobs(2 * this->num_threads),
+      slots(4 * this->num_threads) {}
+
+int64_t ConversionPipeline::Run(GameSource& source, int64_t max_games,
+                                int64_t first_game) {
+  std::thread reader(
+      [this, &source, max_games] { ReadGames(source, max_games); });
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < num_threads; ++i) {
+    workers.emplace_back([this] { ConvertGames(); });
+  }
+
+  while (true) {
+    std::vector<lczero::V6TrainingData> chunks;
+    size_t split;
+    int64_t file_game;
+    {
+      std::unique_lock<std::mutex> lock(slots_mutex);
+      Slot& slot = slots[games_written % slots.size()];
+      slot_ready.wait(lock, [&] {
+        return slot.ready || (reading_done && games_written == games_read);
+      });
+      if (!slot.ready) break;
+      chunks.swap(slot.chunks);
+      split = slot.split;
+      file_game = slot.file_game;
+      slot.ready = false;
+    }
+    auto& writer = writers.WriterForGame(split);
+    writer.SetGame(first_game + file_game);
+    writer.EnqueueChunks(chunks);
+    {
+      std::lock_guard<std::mutex> lock(slots_mutex);
+      games_written++;
+    }
+    slot_free.notify_one();
+    if (games_written % 1000 == 0) {
+      std::cout << games_written << " games written." << std::endl;
+    }
+  }
+
+  reader.join();
+  for (auto& worker : workers) worker.join();
+  return games_written;
+}
+
+void ConversionPipeline::ReadGames(GameSource& source, int64_t max_games) {
+  int64_t game_id = 0;
+  while (game_id < max_games) {
+    {
+      // Do not run further ahead of the writer than the reorder window.
+      std::unique_lock<std::mutex> lock(slots_mutex);
+      slot_free.wait(lock, [&] {
+        return game_id - games_written < static_cast<int64_t>(slots.size());
+      });
+    }
+    auto game = source.NextGame();
+    if (!game) break;
+    jobs.Push(Job{game_id, source.last_game(), std::move(*game)});
+    game_id++;
+    std::lock_guard<std::mutex> lock(slots_mutex);
+    games_read = game_id;
+  }
+  jobs.Close();
+  std::lock_guard<std::mutex> lock(slots_mutex);
+  reading_done = true;
+  slot_ready.notify_all();
+}
+
+void ConversionPipeline::ConvertGames() {
+  while (auto job = jobs.Pop()) {
+    auto chunks = job->game.getChunks(options);
+    size_t split = writers.Route(job->game);
+    std::lock_guard<std::mutex> lock(slots_mutex);
+    Slot& slot = slots[job->game_id % slots.size()];
+    slot.chunks = std::move(chunks);
+    slot.split = split;
+    slot.file_game = job->file_game;
+    slot.ready = true;
+    slot_ready.notify_all();
+  }
+}
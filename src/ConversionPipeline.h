@@ -0,0 +1,66 @@
+#ifndef TRAININGDATA_TOOL_CONVERSIONPIPELINE_H
+#define TRAININGDATA_TOOL_CONVERSIONPIPELINE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "BoundedQueue.h"
+#include "DataSplit.h"
+#include "GameSource.h"
+#include "PGNGame.h"
+#include "TrainingDataWriter.h"
+
+// Converts the games of one PGN file on several threads.
+//
+// A reader thread parses whole games from a GameSource and hands them to a
+// pool of workers running PGNGame::getChunks and picking the game's split.
+// The calling thread acts as the writer and enqueues the results strictly in
+// input order, so the files produced by TrainingDataWriter are identical to
+// a single threaded run.
+class ConversionPipeline {
+ public:
+  ConversionPipeline(Options options, size_t num_threads,
+                     SplitWriters& writers);
+
+  // Converts at most max_games games from source and returns how many were
+  // written. Each game is numbered first_game + source.last_game() for the
+  // pack index.
+  int64_t Run(GameSource& source, int64_t max_games, int64_t first_game);
+
+ private:
+  struct Job {
+    int64_t game_id;
+    // For the pack index, as GameSource::last_game().
+    int64_t file_game;
+    PGNGame game;
+  };
+
+  struct Slot {
+    bool ready = false;
+    size_t split = 0;
+    int64_t file_game = 0;
+    std::vector<lczero::V6TrainingData> chunks;
+  };
+
+  void ReadGames(GameSource& source, int64_t max_games);
+  void ConvertGames();
+
+  const Options options;
+  const size_t num_threads;
+  SplitWriters& writers;
+
+  BoundedQueue<Job> jobs;
+
+  // Reorder window: game i lives in slots[i % slots.size()] until written.
+  std::vector<Slot> slots;
+  int64_t games_read = 0;
+  int64_t games_written = 0;
+  bool reading_done = false;
+  std::mutex slots_mutex;
+  std::condition_variable slot_ready;
+  std::condition_variable slot_free;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include "DataSplit.h"
+
+#include <algorithm>
+#include <charconv>
+#include <ostream>
+
+#include "SanMove.h"
+
+namespace {
+
+constexpr uint64_t kFnvOffsetBasis = 14695981039346656037ull;
+constexpr uint64_t kFnvPrime = 1099511628211ull;
+
+uint64_t fnv1a(uint64_t hash, std::string_view bytes) {
+  for (unsigned char c : bytes) {
+    hash ^= c;
+    hash *= kFnvPrime;
+  }
+  return hash;
+}
+
+bool valid_split_name(std::string_view name) {
+  if (name.empty()) return false;
+  for (char c : name) {
+    if (!(('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') ||
+          ('0' <= c && c <= '9') || c == '_' || c == '-')) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+bool parse_data_splits(std::string_view spec, std::vector<DataSplit>& splits) {
+  splits.clear();
+  uint64_t total = 0;
+  while (!spec.empty()) {
+    std::string_view item = spec.substr(0, spec.find(','));
+    spec.remove_prefix(std::min(spec.size(), item.size() + 1));
+    size_t colon = item.find(':');
+    if (colon == std::string_view::npos) return false;
+    std::string_view name = item.substr(0, colon);
+    std::string_view weight_text = item.substr(colon + 1);
+    uint32_t weight = 0;
+    auto [end, ec] = std::from_chars(
+        weight_text.data(), weight_text.data() + weight_text.size(), weight);
+    if (ec != std::errc() || end != weight_text.data() + weight_text.size() ||
+        weight == 0 || !valid_split_name(name)) {
+      return false;
+    }
+    for (const auto& split : splits) {
+      if (split.name == name) return false;
+    }
+    splits.push_back({std::string(name), weight});
+    total += weight;
+  }
+  // split_for_hash multiplies the total by 32 bits.
+  return !splits.empty() && total <= UINT32_MAX;
+}
+
+uint64_t game_hash(const PGNGame& game) {
+  // A move that cannot be normalized is hashed as written, like the
+  // converter skips it rather than stopping.
+  uint64_t hash = fnv1a(kFnvOffsetBasis, game.getFen());
+  SanBuffer san;
+  for (size_t i = 0; i < game.moves.size(); ++i) {
+    std::string_view move = game.getMove(i);
+    if (normalize_san(move, san)) move = san.view();
+    hash = fnv1a(hash, " ");
+    hash = fnv1a(hash, move);
+  }
+  return hash;
+}
+
+size_t split_for_hash(uint64_t hash, const std::vector<DataSplit>& splits) {
+  uint64_t total = 0;
+  for (const auto& split : splits) total += split.weight;
+  // The top bits, which FNV-1a mixes better than the low ones, scaled to
+  // [0, total).
+  uint64_t point = ((hash >> 32) * total) >> 32;
+  for (size_t i = 0; i + 1 < splits.size(); ++i) {
+    if (point < splits[i].weight) return i;
+    point -= splits[i].weight;
+  }
+  return splits.size() - 1;
+}
+
+SplitWriters::SplitWriters(
+    std::vector<DataSplit> splits,
+    std::vector<std::unique_ptr<TrainingDataWriter>> writers)
+    : splits(std::move(splits)),
+      writers(std::move(writers)),
+      games(this->writers.size(), 0) {}
+
+size_t SplitWriters::Route(const PGNGame& game) const {
+  if (splits.empty()) return 0;
+  return split_for_hash(game_hash(game), splits);
+}
+
+TrainingDataWriter& SplitWriters::WriterForGame(size_t split) {
+  games[split]++;
+  return *writers[split];
+}
+
+void SplitWriters::Finalize() {
+  for (auto& writer : writers) writer->Finalize();
+}
+
+void SplitWriters::Report(std::ostream& out) const {
+  for (size_t i = 0; i < splits.size(); ++i) {
+    out << "  " << splits[i].name << ": " << games[i] << " games" << std::endl;
+  }
+}
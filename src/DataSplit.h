@@ -0,0 +1,60 @@
+#ifndef TRAININGDATA_TOOL_DATASPLIT_H
+#define TRAININGDATA_TOOL_DATASPLIT_H
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "PGNGame.h"
+#include "TrainingDataWriter.h"
+
+// A named share of the games, such as the validation set.
+struct DataSplit {
+  std::string name;
+  uint32_t weight;
+};
+
+// Parses a comma separated list of name:weight pairs, e.g.
+// "train:98,validation:1,test:1". Names may use letters, digits, '_' and
+// '-'; weights are positive integers.
+bool parse_data_splits(std::string_view spec, std::vector<DataSplit>& splits);
+
+// 64-bit FNV-1a hash of the game's starting FEN and its moves as normalized
+// SAN. It depends on nothing but the game, so it is the same on every run,
+// machine and PGN reader, and copies of a game hash alike.
+uint64_t game_hash(const PGNGame& game);
+
+// The split that a game with this hash goes to: each split gets a share of
+// the hash space proportional to its weight.
+size_t split_for_hash(uint64_t hash, const std::vector<DataSplit>& splits);
+
+// Writers for the splits of one conversion. Every game goes in full to the
+// writer of its split, so the splits never share a game.
+class SplitWriters {
+ public:
+  // One writer per split, in the same order, or a single writer if splits is
+  // empty.
+  SplitWriters(std::vector<DataSplit> splits,
+               std::vector<std::unique_ptr<TrainingDataWriter>> writers);
+
+  // Index of the split of game. Thread safe.
+  size_t Route(const PGNGame& game) const;
+
+  // Writer of a split, counting one more game for it.
+  TrainingDataWriter& WriterForGame(size_t split);
+
+  void Finalize();
+
+  // Prints the games written to each split.
+  void Report(std::ostream& out) const;
+
+ private:
+  const std::vector<DataSplit> splits;
+  std::vector<std::unique_ptr<TrainingDataWriter>> writers;
+  std::vector<int64_t> games;
+};
+
+#endif
@@ -0,0 +1,251 @@
+#include "DecompressingReader.h"
+
+#include <zlib.h>
+
+#include <cstring>
+#include <iostream>
+
+#if defined(HAVE_BZIP2)
+#include <bzlib.h>
+#endif
+#if defined(HAVE_ZSTD)
+#include <zstd.h>
+#endif
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace {
+
+const size_t kReadSize = 1 << 20;
+const size_t kBlockSize = 4 << 20;
+const size_t kBlocksAhead = 4;
+
+bool ends_with(const std::string& s, const char* suffix) {
+  size_t n = strlen(suffix);
+  return s.size() >= n && 0 == s.compare(s.size() - n, n, suffix);
+}
+
+class PlainDecoder : public StreamDecoder {
+ public:
+  bool Decode(std::string_view in, std::string& out) override {
+    out.append(in);
+    return true;
+  }
+  bool Finished() const override { return true; }
+};
+
+class GzipDecoder : public StreamDecoder {
+ public:
+  GzipDecoder() { inflateInit2(&stream, 15 + 32); }
+  ~GzipDecoder() override { inflateEnd(&stream); }
+
+  bool Decode(std::string_view in, std::string& out) override {
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    stream.avail_in = static_cast<uInt>(in.size());
+    char buffer[1 << 16];
+    do {
+      stream.next_out = reinterpret_cast<Bytef*>(buffer);
+      stream.avail_out = sizeof(buffer);
+      int ret = inflate(&stream, Z_NO_FLUSH);
+      out.append(buffer, sizeof(buffer) - stream.avail_out);
+      if (ret == Z_STREAM_END) {
+        // Concatenated members, as written by parallel compressors.
+        inflateReset(&stream);
+        finished = true;
+      } else if (ret == Z_OK) {
+        finished = false;
+      } else if (ret == Z_BUF_ERROR) {
+        break;
+      } else if (ret != Z_OK) {
+        return false;
+      }
+    } while (stream.avail_in > 0 || stream.avail_out == 0);
+    return true;
+  }
+
+  bool Finished() const override { return finished; }
+
+ private:
+  z_stream stream{};
+  bool finished = false;
+};
+
+#if defined(HAVE_BZIP2)
+class Bzip2Decoder : public StreamDecoder {
+ public:
+  Bzip2Decoder() { BZ2_bzDecompressInit(&stream, 0, 0); }
+  ~Bzip2Decoder() override { BZ2_bzDecompressEnd(&stream); }
+
+  bool Decode(std::string_view in, std::string& out) override {
+    stream.next_in = const_cast<char*>(in.data());
+    stream.avail_in = static_cast<unsigned>(in.size());
+    char buffer[1 << 16];
+    do {
+      stream.next_out = buffer;
+      stream.avail_out = sizeof(buffer);
+      int ret = BZ2_bzDecompress(&stream);
+      out.append(buffer, sizeof(buffer) - stream.avail_out);
+      if (ret == BZ_STREAM_END) {
+        // Multi-stream files (pbzip2): restart on the remaining input.
+        char* next_in = stream.next_in;
+        unsigned avail_in = stream.avail_in;
+        BZ2_bzDecompressEnd(&stream);
+        stream = bz_stream{};
+        BZ2_bzDecompressInit(&stream, 0, 0);
+        stream.next_in = next_in;
+        stream.avail_in = avail_in;
+        finished = true;
+        if (avail_in == 0) break;
+      } else if (ret == BZ_OK) {
+        finished = false;
+      } else {
+        return false;
+      }
+    } while (stream.avail_in > 0 || stream.avail_out == 0);
+    return true;
+  }
+
+  bool Finished() const override { return finished; }
+
+ private:
+  bz_stream stream{};
+  bool finished = false;
+};
+#endif
+
+#if defined(HAVE_ZSTD)
+class ZstdDecoder : public StreamDecoder {
+ public:
+  ZstdDecoder() : stream(ZSTD_createDCtx()) {
+    // Lichess compresses with long distance matching.
+    ZSTD_DCtx_setParameter(stream, ZSTD_d_windowLogMax, 31);
+  }
+  ~ZstdDecoder() override { ZSTD_freeDCtx(stream); }
+
+  bool Decode(std::string_view in, std::string& out) override {
+    ZSTD_inBuffer input{in.data(), in.size(), 0};
+    char buffer[1 << 16];
+    ZSTD_outBuffer output{buffer, sizeof(buffer), 0};
+    do {
+      output.pos = 0;
+      size_t input_before = input.pos;
+      size_t ret = ZSTD_decompressStream(stream, &output, &input);
+      if (ZSTD_isError(ret)) return false;
+      out.append(buffer, output.pos);
+      // 0 once a frame is decoded and flushed. A call that neither reads nor
+      // writes anything, after the end of a frame, would instead return the
+      // header size of the next one, so it leaves the state alone.
+      if (ret == 0) {
+        finished = true;
+      } else if (input.pos > input_before || output.pos > 0) {
+        finished = false;
+      }
+    } while (input.pos < input.size || output.pos == output.size);
+    return true;
+  }
+
+  bool Finished() const override { return finished; }
+
+ private:
+  ZSTD_DCtx* stream;
+  bool finished = false;
+};
+#endif
+
+std::unique_ptr<StreamDecoder> make_decoder(const unsigned char* magic,
+                                            size_t length) {
+  if (length >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+    return std::make_unique<GzipDecoder>();
+  }
+  if (length >= 3 && 0 == memcmp(magic, "BZh", 3)) {
+#if defined(HAVE_BZIP2)
+    return std::make_unique<Bzip2Decoder>();
+#else
+    std::cerr << "bzip2 input is not supported by this build" << std::endl;
+    return nullptr;
+#endif
+  }
+  if (length >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 &&
+      magic[2] == 0x2f && magic[3] == 0xfd) {
+#if defined(HAVE_ZSTD)
+    return std::make_unique<ZstdDecoder>();
+#else
+    std::cerr << "zstd input is not supported by this build" << std::endl;
+    return nullptr;
+#endif
+  }
+  return std::make_unique<PlainDecoder>();
+}
+
+}  // namespace
+
+bool is_streaming_input(const std::string& file_name) {
+  return file_name == "-" || ends_with(file_name, ".gz") ||
+         ends_with(file_name, ".bz2") || ends_with(file_name, ".zst");
+}
+
+DecompressingReader::DecompressingReader(const std::string& file_name)
+    : file_name(file_name), blocks(kBlocksAhead) {
+  if (file_name == "-") {
+#if defined(_WIN32)
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    file = stdin;
+  } else {
+    file = fopen(file_name.c_str(), "rb");
+  }
+  if (nullptr == file) {
+    std::cerr << "Could not open '" << file_name << "'" << std::endl;
+    blocks.Close();
+    return;
+  }
+  thread = std::thread([this] { Run(); });
+}
+
+DecompressingReader::~DecompressingReader() {
+  // Unblocks the decoder thread if the consumer stopped early.
+  blocks.Close();
+  if (thread.joinable()) thread.join();
+  if (nullptr != file && stdin != file) fclose(file);
+}
+
+bool DecompressingReader::ReadBlock(std::string& out) {
+  auto block = blocks.Pop();
+  if (!block) return false;
+  out.append(*block);
+  return true;
+}
+
+void DecompressingReader::Run() {
+  std::string input(kReadSize, '\0');
+  size_t length = fread(input.data(), 1, input.size(), file);
+  auto decoder = make_decoder(
+      reinterpret_cast<const unsigned char*>(input.data()), length);
+
+  std::string block;
+  bool corrupt = false;
+  while (decoder && length > 0) {
+    if (!decoder->Decode(std::string_view(input.data(), length), block)) {
+      std::cerr << "Corrupt compressed data in '" << file_name << "'"
+                << std::endl;
+      corrupt = true;
+      break;
+    }
+    if (block.size() >= kBlockSize) {
+      if (!blocks.Push(std::move(block))) return;
+      block.clear();
+    }
+    length = fread(input.data(), 1, input.size(), file);
+  }
+  if (ferror(file)) {
+    std::cerr << "Error reading '" << file_name << "'" << std::endl;
+  } else if (decoder && !corrupt && !decoder->Finished()) {
+    std::cerr << "Compressed data in '" << file_name
+              << "' is truncated, the games after the cut are lost"
+              << std::endl;
+  }
+  if (!block.empty()) blocks.Push(std::move(block));
+  blocks.Close();
+}
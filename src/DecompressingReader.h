@@ -0,0 +1,53 @@
+#ifndef TRAININGDATA_TOOL_DECOMPRESSINGREADER_H
+#define TRAININGDATA_TOOL_DECOMPRESSINGREADER_H
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "BoundedQueue.h"
+
+// Incremental decoder for one compressed stream format.
+class StreamDecoder {
+ public:
+  virtual ~StreamDecoder() = default;
+  // Decodes all of in and appends the output to out. Returns false on
+  // corrupt input.
+  virtual bool Decode(std::string_view in, std::string& out) = 0;
+  // True if the input decoded so far ends with a complete stream, false if
+  // it stops partway through one.
+  virtual bool Finished() const = 0;
+};
+
+// True for inputs that must be read as a stream: "-" (stdin) and files
+// compressed with gzip, bzip2 or zstd.
+bool is_streaming_input(const std::string& file_name);
+
+// Reads a file, or stdin for "-", on a background thread and hands out its
+// decompressed contents in blocks. The format is detected from the first
+// bytes, so plain text works too. At most a few blocks are decoded ahead of
+// the consumer. Corrupt input, and compressed input that stops partway
+// through a stream, is reported on std::cerr; the games before it are kept.
+class DecompressingReader {
+ public:
+  explicit DecompressingReader(const std::string& file_name);
+  ~DecompressingReader();
+
+  DecompressingReader(const DecompressingReader&) = delete;
+  DecompressingReader& operator=(const DecompressingReader&) = delete;
+
+  // Appends the next block to out. Returns false at the end of the input.
+  bool ReadBlock(std::string& out);
+
+ private:
+  void Run();
+
+  const std::string file_name;
+  FILE* file = nullptr;
+  BoundedQueue<std::string> blocks;
+  std::thread thread;
+};
+
+#endif
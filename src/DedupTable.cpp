@@ -0,0 +1,61 @@
+#include "DedupTable.h"
+
+#include <algorithm>
+#include <bit>
+#include <functional>
+
+DedupTable::DedupTable(size_t max_records) {
+  size_t capacity = std::bit_ceil(std::max<size_t>(2 * max_records, 16));
+  slots.resize(capacity);
+  mask = capacity - 1;
+  // Only reserved: pages of the arena are touched as records are added.
+  arena.reserve(max_records);
+  counts.reserve(max_records);
+}
+
+size_t DedupTable::FindOrAdd(const lczero::V6TrainingData& chunk,
+                             bool& added) {
+  const PositionFingerprint fingerprint = position_fingerprint(chunk);
+  Slot& slot = Probe(fingerprint, &chunk);
+  added = slot.record == 0;
+  if (!added) return slot.record - 1;
+
+  slot.fingerprint = fingerprint;
+  slot.record = static_cast<uint32_t>(arena.size() + 1);
+  arena.push_back(chunk);
+  counts.push_back(0);
+  if (2 * arena.size() > slots.size()) Grow();
+  return arena.size() - 1;
+}
+
+void DedupTable::Clear() {
+  std::fill(slots.begin(), slots.end(), Slot{});
+  arena.clear();
+  counts.clear();
+}
+
+// The slot holding the position of chunk, or the empty slot where it
+// belongs. Without chunk, the first empty slot for fingerprint.
+DedupTable::Slot& DedupTable::Probe(const PositionFingerprint& fingerprint,
+                                    const lczero::V6TrainingData* chunk) {
+  for (size_t i = fingerprint.low & mask;; i = (i + 1) & mask) {
+    Slot& slot = slots[i];
+    if (slot.record == 0) return slot;
+    // Equal fingerprints of different positions are vanishingly rare, but
+    // must not merge them.
+    if (chunk && slot.fingerprint == fingerprint &&
+        std::equal_to<lczero::V6TrainingData>()(arena[slot.record - 1],
+                                                *chunk)) {
+      return slot;
+    }
+  }
+}
+
+void DedupTable::Grow() {
+  std::vector<Slot> old_slots(2 * slots.size());
+  old_slots.swap(slots);
+  mask = slots.size() - 1;
+  for (const Slot& slot : old_slots) {
+    if (slot.record != 0) Probe(slot.fingerprint, nullptr) = slot;
+  }
+}
@@ -0,0 +1,52 @@
+#ifndef TRAININGDATA_TOOL_DEDUPTABLE_H
+#define TRAININGDATA_TOOL_DEDUPTABLE_H
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "V6TrainingDataHashUtil.h"
+#include "trainingdata/trainingdata_v6.h"
+
+// One record per position, with the number of records merged into it.
+//
+// Records are stored one after the other in an arena, in the order their
+// positions were first seen. They are found through an open addressing
+// table of 24 byte slots holding a PositionFingerprint and an arena index,
+// probed linearly and kept at most half full, so a lookup hashes the
+// position once and compares 16 bytes per slot; whole records are only
+// compared when fingerprints are equal.
+class DedupTable {
+ public:
+  // Room for max_records records without growing the table.
+  explicit DedupTable(size_t max_records);
+
+  // Index of the record with the position of chunk. If there is none, chunk
+  // is copied in with a count of 0 and added is set.
+  size_t FindOrAdd(const lczero::V6TrainingData& chunk, bool& added);
+
+  lczero::V6TrainingData& record(size_t index) { return arena[index]; }
+  uint32_t& count(size_t index) { return counts[index]; }
+  std::span<const lczero::V6TrainingData> records() const { return arena; }
+  size_t size() const { return arena.size(); }
+
+  // Removes every record, keeping the memory.
+  void Clear();
+
+ private:
+  struct Slot {
+    PositionFingerprint fingerprint;
+    uint32_t record;  // Arena index + 1, 0 if the slot is empty.
+  };
+
+  Slot& Probe(const PositionFingerprint& fingerprint,
+              const lczero::V6TrainingData* chunk);
+  void Grow();
+
+  std::vector<Slot> slots;
+  size_t mask;
+  std::vector<lczero::V6TrainingData> arena;
+  std::vector<uint32_t> counts;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "GameFilter.h"
+
+#include <charconv>
+
+#include "SimdScan.h"
+
+namespace {
+
+bool parse_int(std::string_view text, int& value) {
+  auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(),
+                                   value);
+  return ec == std::errc() && end == text.data() + text.size();
+}
+
+bool has_eval(std::string_view movetext) {
+  const char* p = movetext.data();
+  const char* end = p + movetext.size();
+  while ((p = scan_for(p, end, '%')) != end) {
+    if (std::string_view(p, end - p).substr(0, 5) == "%eval") return true;
+    ++p;
+  }
+  return false;
+}
+
+// True if item is one of the entries of the comma separated list.
+bool list_contains(std::string_view list, std::string_view item) {
+  while (!list.empty()) {
+    size_t comma = list.find(',');
+    if (list.substr(0, comma) == item) return true;
+    if (comma == std::string_view::npos) break;
+    list.remove_prefix(comma + 1);
+  }
+  return false;
+}
+
+}  // namespace
+
+std::string_view time_control_class(std::string_view time_control) {
+  if (time_control == "-") return "correspondence";
+  size_t plus = time_control.find('+');
+  int base = 0;
+  int increment = 0;
+  if (plus == std::string_view::npos ||
+      !parse_int(time_control.substr(0, plus), base) ||
+      !parse_int(time_control.substr(plus + 1), increment)) {
+    return {};
+  }
+  int duration = base + 40 * increment;
+  if (duration < 30) return "ultrabullet";
+  if (duration < 180) return "bullet";
+  if (duration < 480) return "blitz";
+  if (duration < 1500) return "rapid";
+  return "classical";
+}
+
+bool GameFilter::active() const {
+  return min_elo > 0 || !time_controls.empty() || standard_only ||
+         require_eval;
+}
+
+bool GameFilter::Accept(const PGNGameText& game) const {
+  if (min_elo > 0 || !time_controls.empty() || standard_only) {
+    int white_elo = 0;
+    int black_elo = 0;
+    std::string_view time_control;
+    std::string_view variant;
+    PGNLexer::ForEachTag(
+        game.tags, [&](std::string_view name, std::string_view value) {
+          if (name == "WhiteElo") {
+            parse_int(value, white_elo);
+          } else if (name == "BlackElo") {
+            parse_int(value, black_elo);
+          } else if (name == "TimeControl") {
+            time_control = value;
+          } else if (name == "Variant") {
+            variant = value;
+          }
+        });
+    if (white_elo < min_elo || black_elo < min_elo) return false;
+    if (!time_controls.empty() &&
+        !list_contains(time_controls, time_control_class(time_control))) {
+      return false;
+    }
+    if (standard_only && !variant.empty() && variant != "Standard" &&
+        variant != "From Position") {
+      return false;
+    }
+  }
+  return !require_eval || has_eval(game.movetext);
+}
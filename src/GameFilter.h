@@ -0,0 +1,34 @@
+#ifndef TRAININGDATA_TOOL_GAMEFILTER_H
+#define TRAININGDATA_TOOL_GAMEFILTER_H
+
+#include <string>
+#include <string_view>
+
+#include "PGNLexer.h"
+
+// Header predicates applied to a game before its moves are parsed. Rejected
+// games are skipped by the GameSource without building a PGNGame or a board.
+struct GameFilter {
+  // Both WhiteElo and BlackElo must be at least this. 0 disables the check.
+  int min_elo = 0;
+  // Comma separated TimeControl classes to keep, out of ultrabullet, bullet,
+  // blitz, rapid, classical and correspondence. Empty keeps all.
+  std::string time_controls;
+  // Only keep games whose Variant tag is missing, "Standard" or "From
+  // Position".
+  bool standard_only = false;
+  // Only keep games with a Lichess %eval annotation.
+  bool require_eval = false;
+
+  // True if any check is enabled.
+  bool active() const;
+
+  bool Accept(const PGNGameText& game) const;
+};
+
+// Lichess' class of a TimeControl tag such as "180+2", from the estimated
+// game duration of base + 40 * increment seconds. "-" is correspondence.
+// Returns an empty view for a missing or unreadable tag.
+std::string_view time_control_class(std::string_view time_control);
+
+#endif
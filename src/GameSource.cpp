@@ -0,0 +1,94 @@
+#include "GameSource.h"
+
+#include <iostream>
+
+#include "PGNIndex.h"
+
+bool GameSource::TakeGame() {
+  if (games_taken >= game_limit) return false;
+  games_taken++;
+  return true;
+}
+
+bool GameSource::Accept(const PGNGameText& text) {
+  if (filter.Accept(text)) return true;
+  filtered++;
+  return false;
+}
+
+PolyglotGameSource::PolyglotGameSource(const std::string& pgn_file_name,
+                                       uint64_t offset, bool keep_comments)
+    : GameSource(keep_comments) {
+  pgn_open_at(pgn, pgn_file_name, offset);
+}
+
+PolyglotGameSource::~PolyglotGameSource() { pgn_close(pgn); }
+
+std::optional<PGNGame> PolyglotGameSource::NextGame() {
+  if (!TakeGame() || !pgn_next_game(pgn)) return std::nullopt;
+  return PGNGame(pgn, keep_comments);
+}
+
+LexerGameSource::LexerGameSource(const std::string& pgn_file_name,
+                                 uint64_t offset, bool keep_comments,
+                                 GameFilter filter)
+    : GameSource(keep_comments, std::move(filter)),
+      file(pgn_file_name),
+      lexer(file.data().substr(std::min<uint64_t>(offset, file.data().size()))) {
+  if (!file.ok()) {
+    std::cerr << "Could not map '" << pgn_file_name << "'" << std::endl;
+  }
+}
+
+std::optional<PGNGame> LexerGameSource::NextGame() {
+  PGNGameText text;
+  while (TakeGame() && lexer.NextGame(text)) {
+    if (Accept(text)) return PGNGame(text, keep_comments);
+  }
+  return std::nullopt;
+}
+
+StreamingGameSource::StreamingGameSource(const std::string& file_name,
+                                         bool keep_comments,
+                                         GameFilter filter)
+    : GameSource(keep_comments, std::move(filter)), reader(file_name) {}
+
+std::optional<PGNGame> StreamingGameSource::NextGame() {
+  while (true) {
+    PGNLexer lexer(std::string_view(buffer).substr(position));
+    PGNGameText text;
+    if (lexer.NextGame(text)) {
+      size_t game_end =
+          text.movetext.data() + text.movetext.size() - buffer.data();
+      // A game running up to the end of the buffer may continue in the next
+      // block.
+      if (game_end < buffer.size() || end_of_input) {
+        position = game_end;
+        if (!TakeGame()) return std::nullopt;
+        if (!Accept(text)) continue;
+        return PGNGame(text, keep_comments);
+      }
+    } else if (end_of_input) {
+      return std::nullopt;
+    }
+    buffer.erase(0, position);
+    position = 0;
+    if (!reader.ReadBlock(buffer)) end_of_input = true;
+  }
+}
+
+std::unique_ptr<GameSource> open_game_source(const std::string& pgn_file_name,
+                                             uint64_t offset, bool fast_lexer,
+                                             bool keep_comments,
+                                             const GameFilter& filter) {
+  if (is_streaming_input(pgn_file_name)) {
+    return std::make_unique<StreamingGameSource>(pgn_file_name, keep_comments,
+                                                 filter);
+  }
+  if (fast_lexer || filter.active()) {
+    return std::make_unique<LexerGameSource>(pgn_file_name, offset,
+                                             keep_comments, filter);
+  }
+  return std::make_unique<PolyglotGameSource>(pgn_file_name, offset,
+                                              keep_comments);
+}
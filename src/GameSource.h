@@ -0,0 +1,99 @@
+#ifndef TRAININGDATA_TOOL_GAMESOURCE_H
+#define TRAININGDATA_TOOL_GAMESOURCE_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "DecompressingReader.h"
+#include "GameFilter.h"
+#include "MappedFile.h"
+#include "PGNGame.h"
+#include "PGNLexer.h"
+
+// Produces the games of one PGN input in file order.
+class GameSource {
+ public:
+  GameSource(bool keep_comments, GameFilter filter = {})
+      : keep_comments(keep_comments), filter(std::move(filter)) {}
+  virtual ~GameSource() = default;
+  // Returns std::nullopt at the end of the input.
+  virtual std::optional<PGNGame> NextGame() = 0;
+
+  // Games rejected by the filter so far.
+  int64_t games_filtered() const { return filtered; }
+
+  // Number of the game NextGame() last returned among the games of the file
+  // from where the source was opened, filtered ones included.
+  int64_t last_game() const { return games_taken - 1; }
+
+  // Ends the input after max_games games of the file, accepted or not, so
+  // that a range of games taken from PGNIndex does not run into the next.
+  void LimitGames(int64_t max_games) { game_limit = max_games; }
+
+ protected:
+  // Counts a game found in the file; false once the limit is reached.
+  bool TakeGame();
+  // Applies the filter to a game found by PGNLexer and counts rejections.
+  bool Accept(const PGNGameText& text);
+
+  const bool keep_comments;
+  const GameFilter filter;
+  int64_t filtered = 0;
+
+ private:
+  int64_t game_limit = INT64_MAX;
+  int64_t games_taken = 0;
+};
+
+// Reads games with polyglot's pgn_next_game / pgn_next_move. Polyglot does
+// not keep the tags, so games are not filtered.
+class PolyglotGameSource : public GameSource {
+ public:
+  PolyglotGameSource(const std::string& pgn_file_name, uint64_t offset,
+                     bool keep_comments);
+  ~PolyglotGameSource() override;
+  std::optional<PGNGame> NextGame() override;
+
+ private:
+  pgn_t pgn[1];
+};
+
+// Reads games from a memory mapping of the file with PGNLexer.
+class LexerGameSource : public GameSource {
+ public:
+  LexerGameSource(const std::string& pgn_file_name, uint64_t offset,
+                  bool keep_comments, GameFilter filter);
+  std::optional<PGNGame> NextGame() override;
+
+ private:
+  MappedFile file;
+  PGNLexer lexer;
+};
+
+// Reads games with PGNLexer from a DecompressingReader, for compressed files
+// and stdin. Only complete games are handed to the lexer, so the buffer holds
+// at most one game beyond the current decompressed block.
+class StreamingGameSource : public GameSource {
+ public:
+  StreamingGameSource(const std::string& file_name, bool keep_comments,
+                      GameFilter filter);
+  std::optional<PGNGame> NextGame() override;
+
+ private:
+  DecompressingReader reader;
+  std::string buffer;
+  size_t position = 0;
+  bool end_of_input = false;
+};
+
+// Opens pgn_file_name at offset, which is 0 or a game start from PGNIndex.
+// Streaming inputs (see is_streaming_input) always use StreamingGameSource
+// and cannot start at an offset. An active filter implies fast_lexer.
+std::unique_ptr<GameSource> open_game_source(const std::string& pgn_file_name,
+                                             uint64_t offset, bool fast_lexer,
+                                             bool keep_comments,
+                                             const GameFilter& filter = {});
+
+#endif
@@ -0,0 +1,113 @@
+#include "HistoryEncoder.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "utils/bititer.h"
+
+#ifndef NDEBUG
+#include "neural/encoder.h"
+#endif
+
+namespace {
+
+// Planes in lc0's bit order, for EncodePositionForNN's en passant fix-up.
+void encode_board(const lczero::ChessBoard& board, int repetitions,
+                  uint64_t* planes) {
+  const lczero::BitBoard ours = board.ours();
+  const lczero::BitBoard theirs = board.theirs();
+  planes[0] = (ours & board.pawns()).as_int();
+  planes[1] = (ours & board.knights()).as_int();
+  planes[2] = (ours & board.bishops()).as_int();
+  planes[3] = (ours & board.rooks()).as_int();
+  planes[4] = (ours & board.queens()).as_int();
+  planes[5] = (ours & board.kings()).as_int();
+  planes[6] = (theirs & board.pawns()).as_int();
+  planes[7] = (theirs & board.knights()).as_int();
+  planes[8] = (theirs & board.bishops()).as_int();
+  planes[9] = (theirs & board.rooks()).as_int();
+  planes[10] = (theirs & board.queens()).as_int();
+  planes[11] = (theirs & board.kings()).as_int();
+  planes[12] = repetitions >= 1 ? ~0ULL : 0;
+}
+
+void reverse_bits(uint64_t* planes, int count) {
+  for (int i = 0; i < count; ++i) {
+    planes[i] = lczero::ReverseBitsInBytes(planes[i]);
+  }
+}
+
+}  // namespace
+
+void HistoryEncoder::AddPosition(const lczero::PositionHistory& history,
+                                 int index) {
+  const lczero::Position& position = history.GetPositionAt(index);
+  auto& block = ring[index % kHistory];
+  encode_board(position.GetBoard(), position.GetRepetitions(),
+               block[0].data());
+  reverse_bits(block[0].data(), kPlanesPerBoard);
+  // The opponent's view swaps our and their pieces and mirrors the ranks,
+  // which is a byte swap in either bit order.
+  for (int i = 0; i < 12; ++i) {
+    lczero::BitBoard plane(block[0][(i + 6) % 12]);
+    plane.Mirror();
+    block[1][i] = plane.as_int();
+  }
+  block[1][12] = block[0][12];
+
+  if (index != 0) return;
+  fill_history =
+      !(history.Starting().GetBoard() == lczero::ChessBoard::kStartposBoard);
+  for (int flip = 0; flip < 2; ++flip) {
+    const lczero::ChessBoard& board =
+        flip ? position.GetThemBoard() : position.GetBoard();
+    uint64_t* planes = fill[flip].data();
+    encode_board(board, position.GetRepetitions(), planes);
+    // Undo the double pawn push that allowed en passant, as lc0 does.
+    if (!board.en_passant().empty()) {
+      const int idx = lczero::GetLowestBit(board.en_passant().as_int());
+      if (idx < 8) {
+        planes[0] += (0x0000000000000100ULL - 0x0000000001000000ULL) << idx;
+      } else {
+        planes[6] += (0x0001000000000000ULL - 0x0000000100000000ULL)
+                     << (idx - 56);
+      }
+    }
+    reverse_bits(planes, kPlanesPerBoard);
+  }
+}
+
+void HistoryEncoder::Encode(const lczero::PositionHistory& history,
+                            uint64_t* planes) {
+  const int length = history.GetLength();
+  while (positions < length) AddPosition(history, positions++);
+
+  const int last = length - 1;
+  for (int i = 0; i < kHistory; ++i) {
+    uint64_t* slot = planes + i * kPlanesPerBoard;
+    if (i <= last) {
+      const Block& block = ring[(last - i) % kHistory][i & 1];
+      std::copy(block.begin(), block.end(), slot);
+    } else if (fill_history) {
+      // Filled slots keep the orientation of position 0.
+      const Block& block = fill[last & 1];
+      std::copy(block.begin(), block.end(), slot);
+    } else {
+      std::fill(slot, slot + kPlanesPerBoard, 0);
+    }
+  }
+
+#ifndef NDEBUG
+  int transform = 0;
+  lczero::InputPlanes expected = lczero::EncodePositionForNN(
+      pblczero::NetworkFormat::INPUT_CLASSICAL_112_PLANE, history, kHistory,
+      lczero::FillEmptyHistory::FEN_ONLY, &transform);
+  for (int i = 0; i < kHistory * kPlanesPerBoard; ++i) {
+    if (planes[i] != lczero::ReverseBitsInBytes(expected[i].mask)) {
+      std::cerr << "Warning: history plane " << i
+                << " differs from EncodePositionForNN" << std::endl;
+      break;
+    }
+  }
+#endif
+}
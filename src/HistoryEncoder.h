@@ -0,0 +1,42 @@
+#ifndef TRAININGDATA_TOOL_HISTORYENCODER_H
+#define TRAININGDATA_TOOL_HISTORYENCODER_H
+
+#include <array>
+#include <cstdint>
+
+#include "chess/position.h"
+
+// Incremental replacement for the 104 history planes of
+// lczero::EncodePositionForNN(INPUT_CLASSICAL_112_PLANE, history, 8,
+// FillEmptyHistory::FEN_ONLY, ...), already bit-reversed into V6 order.
+//
+// Every position of the game is encoded once, in both orientations, into a
+// ring buffer holding the last 8. A new ply then only encodes the newest
+// position and copies the others, taking the flipped orientation for every
+// other one as EncodePositionForNN does.
+class HistoryEncoder {
+ public:
+  static constexpr int kHistory = 8;
+  static constexpr int kPlanesPerBoard = 13;
+
+  // Writes the history planes of history.Last() to planes, which must hold
+  // kHistory * kPlanesPerBoard entries. An encoder follows a single game:
+  // history must have grown by zero or more moves since the last call.
+  void Encode(const lczero::PositionHistory& history, uint64_t* planes);
+
+ private:
+  using Block = std::array<uint64_t, kPlanesPerBoard>;
+
+  void AddPosition(const lczero::PositionHistory& history, int index);
+
+  // ring[i % kHistory][flip] is position i, from its side to move's view
+  // when flip is 0 and from the opponent's when it is 1.
+  std::array<std::array<Block, 2>, kHistory> ring;
+  // Position 0 as EncodePositionForNN repeats it for moves before the start
+  // of a game set up from a FEN, in both orientations.
+  std::array<Block, 2> fill;
+  bool fill_history = false;
+  int positions = 0;
+};
+
+#endif
@@ -0,0 +1,167 @@
+#include "InputFiles.h"
+
+#include <algorithm>
+#include <iostream>
+#include <system_error>
+
+#include "ChunkCodec.h"
+#include "ChunkPack.h"
+
+namespace {
+
+bool readable(std::string_view name) {
+  return nullptr != codec_for_file(name) || is_pack_file(name);
+}
+
+std::filesystem::path absolute_path(const std::filesystem::path& path) {
+  std::error_code error;
+  std::filesystem::path absolute =
+      std::filesystem::absolute(path, error).lexically_normal();
+  // "out/" names the directory "out".
+  if (!absolute.has_filename() && absolute.has_relative_path()) {
+    absolute = absolute.parent_path();
+  }
+  return absolute;
+}
+
+bool is_separator(char c) {
+  return c == '/' || c == std::filesystem::path::preferred_separator;
+}
+
+bool all_digits(std::string_view s) {
+  return !s.empty() && std::all_of(s.begin(), s.end(), [](char c) {
+    return c >= '0' && c <= '9';
+  });
+}
+
+}  // namespace
+
+InputFiles::InputFiles(std::vector<std::string> roots, std::string glob,
+                       const std::vector<std::string>& excluded,
+                       const std::vector<std::string>& output_prefixes)
+    : roots(std::move(roots)), glob(std::move(glob)) {
+  for (const auto& root : this->roots) {
+    absolute_roots.push_back(absolute_path(root));
+  }
+  for (const auto& path : excluded) {
+    this->excluded.push_back(absolute_path(path).string());
+  }
+  for (const auto& prefix : output_prefixes) {
+    // Not absolute_path(): a trailing "-" or "/" belongs to the prefix.
+    std::error_code error;
+    std::filesystem::path absolute =
+        std::filesystem::absolute(prefix, error).lexically_normal();
+    this->output_prefixes.emplace_back(absolute.parent_path(),
+                                       absolute.filename().string());
+  }
+}
+
+std::optional<std::string> InputFiles::Next() {
+  while (true) {
+    if (stack.empty()) {
+      if (next_root == roots.size()) return std::nullopt;
+      const std::string& root = roots[next_root];
+      const std::filesystem::path& absolute = absolute_roots[next_root++];
+      std::error_code error;
+      if (Excluded(absolute)) {
+        std::cerr << "Skipping '" << root << "', an output of this run"
+                  << std::endl;
+      } else if (std::filesystem::is_directory(root, error)) {
+        Enter(root, absolute);
+      } else if (std::filesystem::is_regular_file(root, error)) {
+        if (readable(root)) return root;
+        std::cerr << "'" << root << "' is not training data" << std::endl;
+      } else {
+        std::cerr << "Could not read '" << root << "'" << std::endl;
+      }
+      continue;
+    }
+
+    Directory& directory = stack.back();
+    if (directory.next == directory.entries.size()) {
+      stack.pop_back();
+      continue;
+    }
+    // Copied: entering a subdirectory may move the stack.
+    const std::filesystem::directory_entry entry =
+        directory.entries[directory.next++];
+    std::filesystem::path absolute =
+        directory.absolute / entry.path().filename();
+    std::error_code error;
+    if (Excluded(absolute)) continue;
+    if (entry.is_directory(error) && !entry.is_symlink(error)) {
+      Enter(entry.path(), std::move(absolute));
+    } else if (entry.is_regular_file(error) && Wanted(entry.path())) {
+      return entry.path().string();
+    }
+  }
+}
+
+void InputFiles::Enter(const std::filesystem::path& path,
+                       std::filesystem::path absolute) {
+  Directory directory;
+  directory.absolute = std::move(absolute);
+  std::error_code error;
+  for (std::filesystem::directory_iterator it(path, error), end;
+       !error && it != end; it.increment(error)) {
+    directory.entries.push_back(*it);
+  }
+  if (error) {
+    std::cerr << "Could not list '" << path.string() << "': "
+              << error.message() << std::endl;
+  }
+  std::sort(directory.entries.begin(), directory.entries.end(),
+            [](const auto& a, const auto& b) {
+              return a.path().filename() < b.path().filename();
+            });
+  stack.push_back(std::move(directory));
+}
+
+bool InputFiles::Wanted(const std::filesystem::path& path) const {
+  const std::string name = path.filename().string();
+  return readable(name) && (glob.empty() || glob_match(glob, name));
+}
+
+bool InputFiles::Excluded(const std::filesystem::path& absolute) const {
+  const std::string path = absolute.string();
+  for (const auto& prefix : excluded) {
+    // The prefix must end at a path component.
+    if (path.compare(0, prefix.size(), prefix) == 0 &&
+        (path.size() == prefix.size() || is_separator(path[prefix.size()]) ||
+         is_separator(prefix.back()))) {
+      return true;
+    }
+  }
+  for (const auto& [directory, name_prefix] : output_prefixes) {
+    const std::string name = absolute.filename().string();
+    if (name.compare(0, name_prefix.size(), name_prefix) == 0 &&
+        all_digits(std::string_view(name).substr(name_prefix.size())) &&
+        absolute.parent_path() == directory) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool glob_match(std::string_view pattern, std::string_view name) {
+  // Backtracks to the last '*' only, which is enough without character
+  // classes.
+  size_t p = 0, n = 0;
+  size_t star = std::string_view::npos, star_n = 0;
+  while (n < name.size()) {
+    if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+      p++;
+      n++;
+    } else if (p < pattern.size() && pattern[p] == '*') {
+      star = p++;
+      star_n = n;
+    } else if (star != std::string_view::npos) {
+      p = star + 1;
+      n = ++star_n;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.size() && pattern[p] == '*') p++;
+  return p == pattern.size();
+}
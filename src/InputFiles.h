@@ -0,0 +1,71 @@
+#ifndef TRAININGDATA_TOOL_INPUTFILES_H
+#define TRAININGDATA_TOOL_INPUTFILES_H
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Lists the training data files under several roots without building the
+// whole list first: only the entries of the directories on the path to the
+// current file are held, so the first file is returned as soon as its
+// directory is listed, however many files there are.
+//
+// Roots are visited in the order given. A directory is walked recursively,
+// its entries in name order, each subdirectory in full at its place in that
+// order; symbolic links to directories are not followed. Only files that a
+// codec or the pack reader can read are returned, and if glob is not empty
+// only those whose name (not the path) matches it; the glob does not apply
+// to roots that are files.
+//
+// Paths in excluded, and everything under them, are skipped, roots included,
+// as are the directories named by one of output_prefixes followed by a
+// number, the way TrainingDataWriter names its output directories. Paths
+// are compared whole component by component once made absolute, so
+// excluding "out.tdpack" does not skip "out.tdpack2". This keeps the
+// outputs of the running process, which may lie under a root, out of its
+// input.
+class InputFiles {
+ public:
+  // The names TrainingDataWriter gives its files.
+  static constexpr const char* kWriterGlob = "game_*";
+
+  InputFiles(std::vector<std::string> roots, std::string glob = kWriterGlob,
+             const std::vector<std::string>& excluded = {},
+             const std::vector<std::string>& output_prefixes = {});
+
+  // The next file, or std::nullopt once every root is done.
+  std::optional<std::string> Next();
+
+ private:
+  struct Directory {
+    // Absolute, so that the paths of entries are built without resolving
+    // each one.
+    std::filesystem::path absolute;
+    std::vector<std::filesystem::directory_entry> entries;
+    size_t next = 0;
+  };
+
+  void Enter(const std::filesystem::path& path,
+             std::filesystem::path absolute);
+  bool Wanted(const std::filesystem::path& path) const;
+  bool Excluded(const std::filesystem::path& absolute) const;
+
+  std::vector<std::string> roots;
+  std::vector<std::filesystem::path> absolute_roots;
+  std::string glob;
+  std::vector<std::string> excluded;
+  // Directory and file name prefix of each output prefix.
+  std::vector<std::pair<std::filesystem::path, std::string>> output_prefixes;
+  size_t next_root = 0;
+  std::vector<Directory> stack;
+};
+
+// Shell style wildcards: '*' matches any run of characters, '?' any single
+// one.
+bool glob_match(std::string_view pattern, std::string_view name);
+
+#endif
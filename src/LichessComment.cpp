@@ -0,0 +1,100 @@
+#include "LichessComment.h"
+
+#include <charconv>
+
+namespace {
+
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+// Length of the digit run starting at s[pos].
+size_t digits_at(std::string_view s, size_t pos) {
+  size_t end = pos;
+  while (end < s.size() && is_digit(s[end])) ++end;
+  return end - pos;
+}
+
+// Parses "-?\d+(\.\d+)?" at the start of s. Returns the number of characters
+// consumed, or 0 if s does not start with such a number.
+size_t parse_decimal(std::string_view s, float& value) {
+  size_t pos = (!s.empty() && s[0] == '-') ? 1 : 0;
+  size_t int_digits = digits_at(s, pos);
+  if (int_digits == 0) return 0;
+  pos += int_digits;
+  if (pos < s.size() && s[pos] == '.') {
+    size_t frac_digits = digits_at(s, pos + 1);
+    if (frac_digits > 0) pos += 1 + frac_digits;
+  }
+  auto result = std::from_chars(s.data(), s.data() + pos, value);
+  return result.ec == std::errc() ? pos : 0;
+}
+
+// Parses "-?\d+" at the start of s, as parse_decimal.
+size_t parse_integer(std::string_view s, int& value) {
+  size_t sign = (!s.empty() && s[0] == '-') ? 1 : 0;
+  if (digits_at(s, sign) == 0) return 0;
+  auto result = std::from_chars(s.data(), s.data() + s.size(), value);
+  return result.ec == std::errc() ? result.ptr - s.data() : 0;
+}
+
+// "[%eval 0.17]" or "[%eval #-3]"; body is the text after "[%eval ".
+bool parse_eval(std::string_view body, LichessAnnotations& annotations) {
+  if (!body.empty() && body[0] == '#') {
+    int mate_in;
+    size_t length = parse_integer(body.substr(1), mate_in);
+    if (length == 0 || body.substr(1 + length, 1) != "]") return false;
+    annotations.eval_is_mate = true;
+    annotations.mate_in = mate_in;
+    annotations.eval = 0.0f;
+  } else {
+    float eval;
+    size_t length = parse_decimal(body, eval);
+    if (length == 0 || body.substr(length, 1) != "]") return false;
+    annotations.eval_is_mate = false;
+    annotations.eval = eval;
+  }
+  annotations.has_eval = true;
+  return true;
+}
+
+// "[%clk 0:03:00]", seconds may carry a fraction; body is the text after
+// "[%clk ".
+bool parse_clock(std::string_view body, LichessAnnotations& annotations) {
+  int hours;
+  int minutes;
+  float seconds;
+  size_t pos = parse_integer(body, hours);
+  if (pos == 0 || hours < 0 || body.substr(pos, 1) != ":") return false;
+  size_t length = parse_integer(body.substr(++pos), minutes);
+  if (length == 0 || minutes < 0) return false;
+  pos += length;
+  if (body.substr(pos, 1) != ":") return false;
+  length = parse_decimal(body.substr(++pos), seconds);
+  if (length == 0 || seconds < 0) return false;
+  pos += length;
+  if (body.substr(pos, 1) != "]") return false;
+  annotations.has_clock = true;
+  annotations.clock_seconds = hours * 3600.0f + minutes * 60.0f + seconds;
+  return true;
+}
+
+}  // namespace
+
+bool parse_lichess_annotations(std::string_view comment,
+                               LichessAnnotations& annotations) {
+  static constexpr std::string_view kEval = "[%eval ";
+  static constexpr std::string_view kClock = "[%clk ";
+  bool found = false;
+  size_t pos = 0;
+  while ((pos = comment.find("[%", pos)) != std::string_view::npos) {
+    std::string_view rest = comment.substr(pos);
+    // Like the regex it replaces, the first well formed eval wins.
+    if (!annotations.has_eval && rest.substr(0, kEval.size()) == kEval) {
+      found |= parse_eval(rest.substr(kEval.size()), annotations);
+    } else if (!annotations.has_clock &&
+               rest.substr(0, kClock.size()) == kClock) {
+      found |= parse_clock(rest.substr(kClock.size()), annotations);
+    }
+    pos += 2;
+  }
+  return found;
+}
@@ -0,0 +1,31 @@
+#ifndef TRAININGDATA_TOOL_LICHESSCOMMENT_H
+#define TRAININGDATA_TOOL_LICHESSCOMMENT_H
+
+#include <string_view>
+
+// Annotations Lichess embeds in move comments, for example
+// "{ [%eval 0.17] [%clk 0:03:00] }" or "{ [%eval #-3] }".
+struct LichessAnnotations {
+  bool has_eval = false;
+  // Set for "[%eval #n]"; mate_in is then the signed number of moves.
+  bool eval_is_mate = false;
+  float eval = 0.0f;
+  int mate_in = 0;
+
+  bool has_clock = false;
+  float clock_seconds = 0.0f;
+
+  // Engine score in pawns, with forced mates mapped to +/-128.
+  float score() const {
+    if (!eval_is_mate) return eval;
+    return mate_in < 0 ? -128.0f : 128.0f;
+  }
+};
+
+// Reads every [%eval] and [%clk] annotation of comment in a single pass,
+// without allocating. Malformed annotations are ignored. Returns true if
+// anything was found.
+bool parse_lichess_annotations(std::string_view comment,
+                               LichessAnnotations& annotations);
+
+#endif
@@ -0,0 +1,69 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const std::string& file_name) {
+  HANDLE file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return;
+  file_handle = file;
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) return;
+  length = static_cast<size_t>(size.QuadPart);
+  if (length == 0) {
+    mapped = true;
+    return;
+  }
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr) return;
+  mapping_handle = mapping;
+  begin = static_cast<const char*>(
+      MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  mapped = begin != nullptr;
+}
+
+MappedFile::~MappedFile() {
+  if (begin != nullptr) UnmapViewOfFile(begin);
+  if (mapping_handle != nullptr) CloseHandle(mapping_handle);
+  if (file_handle != nullptr) CloseHandle(file_handle);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& file_name) {
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) return;
+  struct stat st;
+  if (fstat(fd, &st) == 0) {
+    length = static_cast<size_t>(st.st_size);
+    if (length == 0) {
+      mapped = true;
+    } else {
+      void* addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr != MAP_FAILED) {
+        madvise(addr, length, MADV_SEQUENTIAL);
+        begin = static_cast<const char*>(addr);
+        mapped = true;
+      }
+    }
+  }
+  // The mapping stays valid after the descriptor is closed.
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (begin != nullptr) munmap(const_cast<char*>(begin), length);
+}
+
+#endif
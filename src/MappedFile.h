@@ -0,0 +1,29 @@
+#ifndef TRAININGDATA_TOOL_MAPPEDFILE_H
+#define TRAININGDATA_TOOL_MAPPEDFILE_H
+
+#include <string>
+#include <string_view>
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& file_name);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool ok() const { return mapped; }
+  std::string_view data() const { return {begin, length}; }
+
+ private:
+  const char* begin = nullptr;
+  size_t length = 0;
+  bool mapped = false;
+#if defined(_WIN32)
+  void* file_handle = nullptr;
+  void* mapping_handle = nullptr;
+#endif
+};
+
+#endif
@@ -1,11 +1,12 @@
 #include "PGNGame.h"
+#include "LichessComment.h"
+#include "SanMove.h"
 #include "StaticEvaluator.h"
 #include "trainingdata.h"
 
 #include <cmath>
 #include <cstring>
 #include <iostream>
-#include <regex>
 #include <sstream>
 #include <vector>
 
@@ -13,106 +14,106 @@ float convert_sf_score_to_win_probability(float score) {
   return 2 / (1 + exp(-0.4 * score)) - 1;
 }
 
-bool extract_lichess_comment_score(const char* comment, float& Q) {
-  std::string s(comment);
-  // Note: brackets must be escaped with \\ in C++ regex strings
-  static std::regex rgx("\\[%eval (-?\\d+(\\.\\d+)?)\\]");
-  static std::regex rgx2("\\[%eval #(-?\\d+)\\]");
-  std::smatch matches;
-  try {
-    if (std::regex_search(s, matches, rgx)) {
-      Q = std::stof(matches[1].str());
-      return true;
-    } else if (std::regex_search(s, matches, rgx2)) {
-      Q = matches[1].str().at(0) == '-' ? -128.0f : 128.0f;
-      return true;
-    }
-  } catch (const std::exception& e) {
-    // Failed to parse eval score
-    return false;
+PGNGame::PGNGame(pgn_t* pgn, bool keep_comments) {
+  setHeaders(pgn->result, pgn->fen);
+
+  char str[256];
+  while (pgn_next_move(pgn, str, 256)) {
+    addMove(str, pgn->last_read_nag,
+            keep_comments ? pgn->last_read_comment : "");
   }
-  return false;
 }
 
-lczero::Move poly_move_to_lc0_move(move_t move, board_t* board,
-                                   bool is_black_move) {
-  // IMPORTANT: move_from() and move_to() return polyglot 0x88 format squares
-  // lczero::Square::FromIdx() expects 0-63 indices
-  // Use square_to_64() to convert from 0x88 to 0-63
-  int from_0x88 = move_from(move);
-  int to_0x88 = move_to(move);
-  int from_64 = square_to_64(from_0x88);
-  int to_64 = square_to_64(to_0x88);
-
-  lczero::Square from = lczero::Square::FromIdx(from_64);
-  lczero::Square to = lczero::Square::FromIdx(to_64);
-  lczero::Move m;
-
-  if (move_is_promote(move)) {
-    lczero::PieceType prom_type = lczero::kKnight;
-    // Polyglot: 0=None, 1=Kn, 2=Bi, 3=Ro, 4=Qu
-    int promo = (move >> 12) & 7;
-    switch (promo) {
-      case 1:
-        prom_type = lczero::kKnight;
-        break;
-      case 2:
-        prom_type = lczero::kBishop;
+PGNGame::PGNGame(const PGNGameText& text, bool keep_comments) {
+  std::string_view result = PGNLexer::FindTag(text.tags, "Result");
+  setHeaders(result.empty() ? "*" : result,
+             PGNLexer::FindTag(text.tags, "FEN"));
+
+  // Like polyglot's last_read_comment / last_read_nag, a move carries the
+  // comment and NAG read since the previous move.
+  std::string_view comment;
+  std::string_view nag;
+  PGNLexer::MoveTokenizer tokens(text.movetext);
+  PGNToken token;
+  while (tokens.Next(token)) {
+    switch (token.type) {
+      case PGNTokenType::kMove:
+        addMove(token.text, nag, comment);
+        comment = {};
+        nag = {};
         break;
-      case 3:
-        prom_type = lczero::kRook;
+      case PGNTokenType::kComment:
+        if (keep_comments) comment = token.text;
         break;
-      case 4:
-        prom_type = lczero::kQueen;
+      case PGNTokenType::kNag:
+        nag = token.text;
         break;
     }
-    m = lczero::Move::WhitePromotion(from, to, prom_type);
-    // Need to flip for black moves (except castling)
-    if (is_black_move) {
-      m.Flip();
-    }
-  } else if (move_is_castle(move, board)) {
-    // For castling, files don't change with perspective, only ranks do
-    // So castling is already in the correct orientation
-    lczero::File rook_file =
-        (to.file().idx > from.file().idx) ? lczero::kFileH : lczero::kFileA;
-    m = lczero::Move::WhiteCastling(from.file(), rook_file);
-    // Don't flip castling moves - they're perspective-independent
-  } else if (move_is_en_passant(move, board)) {
-    m = lczero::Move::WhiteEnPassant(from, to);
-    if (is_black_move) {
-      m.Flip();
-    }
-  } else {
-    m = lczero::Move::White(from, to);
-    // Lc0's board is always kept from white's perspective internally.
-    // After ApplyMove(), Position::Mirror() is called to switch perspective.
-    // When is_black_move is true, the polyglot board is from black's
-    // perspective (after the previous mirror), so we need to flip the move
-    // coordinates to white's perspective before applying it in lc0.
-    if (is_black_move) {
-      m.Flip();
-    }
   }
+}
 
-  return m;
+void PGNGame::setHeaders(std::string_view result, std::string_view fen) {
+  result = result.substr(0, PGN_STRING_SIZE - 1);
+  fen = fen.substr(0, PGN_STRING_SIZE - 1);
+  result_length = static_cast<uint16_t>(result.size());
+  fen_length = static_cast<uint16_t>(fen.size());
+  text.append(result);
+  text.append(fen);
 }
 
-PGNGame::PGNGame(pgn_t* pgn) {
-  strncpy(this->result, pgn->result, PGN_STRING_SIZE);
-  strncpy(this->fen, pgn->fen, PGN_STRING_SIZE);
+void PGNGame::addMove(std::string_view move, std::string_view nag,
+                      std::string_view comment) {
+  move = move.substr(0, UINT8_MAX);
+  nag = nag.substr(0, UINT8_MAX);
+  comment = comment.substr(0, UINT16_MAX);
+  moves.push_back({static_cast<uint32_t>(text.size()),
+                   static_cast<uint8_t>(move.size()),
+                   static_cast<uint8_t>(nag.size()),
+                   static_cast<uint16_t>(comment.size())});
+  text.append(move);
+  text.append(nag);
+  text.append(comment);
+}
 
-  char str[256];
-  while (pgn_next_move(pgn, str, 256)) {
-    this->moves.emplace_back(str, pgn->last_read_comment, pgn->last_read_nag);
-  }
+std::string_view PGNGame::getResult() const {
+  return std::string_view(text).substr(0, result_length);
+}
+
+std::string_view PGNGame::getFen() const {
+  return std::string_view(text).substr(result_length, fen_length);
+}
+
+std::string_view PGNGame::getMove(size_t i) const {
+  return std::string_view(text).substr(moves[i].offset, moves[i].move_length);
+}
+
+std::string_view PGNGame::getNag(size_t i) const {
+  return std::string_view(text).substr(moves[i].offset + moves[i].move_length,
+                                       moves[i].nag_length);
+}
+
+std::string_view PGNGame::getComment(size_t i) const {
+  return std::string_view(text).substr(
+      moves[i].offset + moves[i].move_length + moves[i].nag_length,
+      moves[i].comment_length);
+}
+
+size_t PGNGame::getMemoryUsage() const {
+  return sizeof(PGNGame) + text.capacity() +
+         moves.capacity() * sizeof(PGNMoveInfo);
 }
 
 std::vector<lczero::V6TrainingData> PGNGame::getChunks(Options options) const {
-  std::vector<lczero::V6TrainingData> chunks;
+  VectorChunkSink sink;
+  getChunks(options, sink);
+  return std::move(sink.chunks);
+}
+
+void PGNGame::getChunks(Options options, ChunkSink& sink) const {
   lczero::ChessBoard starting_board;
-  std::string starting_fen =
-      std::strlen(this->fen) > 0 ? this->fen : lczero::ChessBoard::kStartposFen;
+  std::string starting_fen = !getFen().empty()
+                                ? std::string(getFen())
+                                : lczero::ChessBoard::kStartposFen;
 
   {
     std::istringstream fen_str(starting_fen);
@@ -135,105 +136,68 @@ std::vector<lczero::V6TrainingData> PGNGame::getChunks(Options options) const {
 
   lczero::PositionHistory position_history;
   position_history.Reset(starting_board, 0, 0);
-  board_t board[1];
-  board_from_fen(board, starting_fen.c_str());
 
   lczero::GameResult game_result;
-  if (strcmp(this->result, "1-0") == 0) {
+  if (getResult() == "1-0") {
     game_result = lczero::GameResult::WHITE_WON;
-  } else if (strcmp(this->result, "0-1") == 0) {
+  } else if (getResult() == "0-1") {
     game_result = lczero::GameResult::BLACK_WON;
-  } else if (strcmp(this->result, "1/2-1/2") == 0) {
+  } else if (getResult() == "1/2-1/2") {
     game_result = lczero::GameResult::DRAW;
   } else {
     game_result = lczero::GameResult::DRAW;  // fallback for unrecognized result
   }
 
-  char str[256];
-  // Iterate over moves with robust SAN cleaning and safe handling
+  HistoryEncoder history_encoder;
+  SanBuffer san;
   for (size_t i = 0; i < this->moves.size(); ++i) {
-    const auto& pgn_move = this->moves[i];
-
-    // ----- SAN cleaning -------------------------------------------------
-    std::string san = pgn_move.move;
-    // Trim leading/trailing whitespace
-    san.erase(0, san.find_first_not_of(" \t\r\n"));
-    if (!san.empty()) san.erase(san.find_last_not_of(" \t\r\n") + 1);
-    // Remove move numbers like "1.", "23..."
-    size_t dotPos = san.find('.');
-    if (dotPos != std::string::npos) {
-      bool precedingDigits = true;
-      for (size_t j = 0; j < dotPos; ++j) {
-        if (!isdigit(san[j])) {
-          precedingDigits = false;
-          break;
-        }
-      }
-      if (precedingDigits) {
-        san = san.substr(dotPos + 1);
-        san.erase(0, san.find_first_not_of(" \t"));
-      }
-    }
-    // Discard any PGN comment start '{' and everything after it
-    size_t bracePos = san.find('{');
-    if (bracePos != std::string::npos) san = san.substr(0, bracePos);
-    // Remove trailing annotation symbols (!, ?, +, #, =)
-    while (!san.empty() &&
-           (san.back() == '!' || san.back() == '?' || san.back() == '+' ||
-            san.back() == '#' || san.back() == '=')) {
-      san.pop_back();
-    }
-    // Remove trailing period
-    if (!san.empty() && san.back() == '.') san.pop_back();
-    // -------------------------------------------------------------------
-
-    int move = move_from_san(san.c_str(), board);
-    if (move == MoveNone || !move_is_legal(move, board)) {
+    const std::string_view pgn_move = getMove(i);
+    const std::string_view comment = getComment(i);
+    const std::string_view nag = getNag(i);
+
+    const bool is_black_move = position_history.IsBlackToMove();
+    const lczero::ChessBoard& board = position_history.Last().GetBoard();
+    auto legal_moves = board.GenerateLegalMoves();
+
+    lczero::Move lc0_move;
+    if (!normalize_san(pgn_move, san) ||
+        !resolve_san(san.view(), board, legal_moves, is_black_move,
+                     lc0_move)) {
       if (options.verbose) {
-        std::cout << "Skipping illegal move \"" << pgn_move.move
-                  << "\" (parsed as \"" << san << "\")" << std::endl;
+        std::cout << "Skipping illegal move \"" << pgn_move
+                  << "\" (parsed as \"" << san.view() << "\")" << std::endl;
       }
       continue;
     }
 
     if (options.verbose) {
-      move_to_san(move, board, str, 256);
-      std::cout << "Read move: " << str << std::endl;
-      if (pgn_move.comment[0]) {
-        std::cout << str << " pgn comment: " << pgn_move.comment << std::endl;
+      std::cout << "Read move: " << san.view() << std::endl;
+      if (!comment.empty()) {
+        std::cout << san.view() << " pgn comment: " << comment << std::endl;
       }
     }
 
     bool bad_move = false;
-    if (pgn_move.nag[0]) {
-      if (pgn_move.nag[0] == '2' || pgn_move.nag[0] == '4' ||
-          pgn_move.nag[0] == '5' || pgn_move.nag[0] == '6') {
+    if (!nag.empty()) {
+      if (nag[0] == '2' || nag[0] == '4' || nag[0] == '5' || nag[0] == '6') {
         bad_move = true;
       }
     }
 
-    // Determine if it's black's move by checking if the position history
-    // indicates so
-    bool is_black_move = position_history.IsBlackToMove();
-    lczero::Move lc0_move = poly_move_to_lc0_move(move, board, is_black_move);
-
-    auto legal_moves = position_history.Last().GetBoard().GenerateLegalMoves();
-
     // Extract scores and convert to win probability
     float Q = 0.0f;
     if (options.lichess_mode) {
-      if (pgn_move.comment[0]) {
-        float lichess_score;
-        bool success =
-            extract_lichess_comment_score(pgn_move.comment, lichess_score);
-        if (success) {
-          Q = convert_sf_score_to_win_probability(lichess_score);
+      if (!comment.empty()) {
+        LichessAnnotations annotations;
+        parse_lichess_annotations(comment, annotations);
+        if (annotations.has_eval) {
+          Q = convert_sf_score_to_win_probability(annotations.score());
         } else if (options.verbose) {
-          std::cout << "Skipping Lichess eval for move \"" << pgn_move.move
+          std::cout << "Skipping Lichess eval for move \"" << pgn_move
                     << "\" – no %eval found" << std::endl;
         }
       } else if (options.verbose) {
-        std::cout << "No Lichess comment for move \"" << pgn_move.move
+        std::cout << "No Lichess comment for move \"" << pgn_move
                   << "\" – skipping eval" << std::endl;
       }
     } else {
@@ -248,9 +212,9 @@ std::vector<lczero::V6TrainingData> PGNGame::getChunks(Options options) const {
     if (!(bad_move && options.lichess_mode)) {
       // Generate training data
       // For non-Stockfish mode, best_move = played_move, visits = 1
-      lczero::V6TrainingData chunk = get_v6_training_data(
-          game_result, position_history, lc0_move, legal_moves, Q, lc0_move, 1);
-      chunks.push_back(chunk);
+      options.fill_training_data(sink.Append(), game_result,
+                                 position_history, lc0_move, legal_moves, Q,
+                                 lc0_move, 1, &history_encoder);
       if (options.verbose) {
         std::string result;
         switch (game_result) {
@@ -274,12 +238,9 @@ std::vector<lczero::V6TrainingData> PGNGame::getChunks(Options options) const {
 
     // Execute move
     position_history.Append(lc0_move);
-    move_do(board, move);
   }
 
   if (options.verbose) {
     std::cout << "Game end." << std::endl;
   }
-
-  return chunks;
 }
\ No newline at end of file
@@ -1,27 +1,60 @@
 #if !defined(PGN_GAME_H_INCLUDED)
 #define PGN_GAME_H_INCLUDED
 
+#include <string>
+#include <string_view>
+#include <vector>
+
 #include "neural/encoder.h"
 #include "neural/network.h"
 #include "trainingdata/trainingdata_v6.h"
 #include "pgn.h"
 #include "polyglot_lib.h"
+#include "ChunkSink.h"
+#include "PGNLexer.h"
 #include "PGNMoveInfo.h"
-
-class PGNMoveInfo;
+#include "trainingdata.h"
 
 struct Options {
   bool verbose = false;
   bool lichess_mode = false;
+  // Chosen once per run from -input-format.
+  TrainingDataFiller fill_training_data = fill_v6_training_data;
+
+  bool keepComments() const { return verbose || lichess_mode; }
 };
 
 struct PGNGame {
-  char result[PGN_STRING_SIZE];
-  char fen[PGN_STRING_SIZE];
+  // Packed text of the game: result, FEN, then every move's SAN, NAG and
+  // comment. moves index into it.
+  std::string text;
   std::vector<PGNMoveInfo> moves;
 
-  explicit PGNGame(pgn_t* pgn);
+  // Comments are only needed to read Lichess evals or for verbose output;
+  // without keep_comments they are not stored at all.
+  PGNGame(pgn_t* pgn, bool keep_comments);
+  PGNGame(const PGNGameText& text, bool keep_comments);
+
+  std::string_view getResult() const;
+  std::string_view getFen() const;
+  std::string_view getMove(size_t i) const;
+  std::string_view getNag(size_t i) const;
+  std::string_view getComment(size_t i) const;
+
+  // Heap and inline bytes held by this game.
+  size_t getMemoryUsage() const;
+
+  // Appends a record for every position of the game to sink.
+  void getChunks(Options options, ChunkSink& sink) const;
   std::vector<lczero::V6TrainingData> getChunks(Options options) const;
+
+ private:
+  void setHeaders(std::string_view result, std::string_view fen);
+  void addMove(std::string_view move, std::string_view nag,
+               std::string_view comment);
+
+  uint16_t result_length = 0;
+  uint16_t fen_length = 0;
 };
 
 #endif
@@ -0,0 +1,164 @@
+#include "PGNIndex.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+const char kIndexMagic[8] = {'P', 'G', 'N', 'I', 'D', 'X', '0', '1'};
+
+uint64_t current_file_size(const std::string& name) {
+  return std::filesystem::file_size(name);
+}
+
+int64_t current_file_mtime(const std::string& name) {
+  return std::filesystem::last_write_time(name).time_since_epoch().count();
+}
+
+}  // namespace
+
+std::string PGNIndex::SidecarName(const std::string& pgn_file_name) {
+  return pgn_file_name + ".pgnidx";
+}
+
+PGNIndex PGNIndex::LoadOrBuild(const std::string& pgn_file_name) {
+  if (auto index = Load(pgn_file_name)) return std::move(*index);
+  std::cout << "Indexing '" << pgn_file_name << "'" << std::endl;
+  PGNIndex index = Build(pgn_file_name);
+  if (!index.Save(pgn_file_name)) {
+    std::cerr << "Could not write " << SidecarName(pgn_file_name) << std::endl;
+  }
+  std::cout << "Indexed " << index.size() << " games." << std::endl;
+  return index;
+}
+
+uint64_t PGNIndex::RangeBytes(GameRange range) const {
+  if (range.begin >= static_cast<int64_t>(offsets.size())) return 0;
+  uint64_t end = range.end < static_cast<int64_t>(offsets.size())
+                     ? offsets[range.end]
+                     : file_size;
+  return end - offsets[range.begin];
+}
+
+PGNIndex PGNIndex::Build(const std::string& pgn_file_name) {
+  PGNIndex index;
+  index.file_size = current_file_size(pgn_file_name);
+  index.file_mtime = current_file_mtime(pgn_file_name);
+
+  FILE* file = fopen(pgn_file_name.c_str(), "rb");
+  if (nullptr == file) return index;
+
+  // A game starts at the first tag line that follows movetext (or the start
+  // of the file). Brace and semicolon comments are skipped so that a comment
+  // line beginning with "[%eval" is not mistaken for a tag.
+  bool line_start = true;
+  bool skip_line = false;
+  bool in_brace = false;
+  bool in_tags = false;
+  uint64_t pos = 0;
+  std::vector<char> buffer(1 << 20);
+  size_t n;
+  while ((n = fread(buffer.data(), 1, buffer.size(), file)) > 0) {
+    for (size_t i = 0; i < n; ++i, ++pos) {
+      char c = buffer[i];
+      if (c == '\n') {
+        line_start = true;
+        skip_line = false;
+        continue;
+      }
+      if (skip_line) continue;
+      if (in_brace) {
+        if (c == '}') in_brace = false;
+        line_start = false;
+        continue;
+      }
+      if (c == ' ' || c == '\t' || c == '\r') continue;
+      if (line_start && c == '[') {
+        if (!in_tags) index.offsets.push_back(pos);
+        in_tags = true;
+        skip_line = true;
+        continue;
+      }
+      if (line_start) in_tags = false;
+      line_start = false;
+      if (c == '{') {
+        in_brace = true;
+      } else if (c == ';') {
+        skip_line = true;
+      }
+    }
+  }
+  fclose(file);
+  return index;
+}
+
+std::optional<PGNIndex> PGNIndex::Load(const std::string& pgn_file_name) {
+  std::ifstream in(SidecarName(pgn_file_name), std::ios::binary);
+  if (!in) return std::nullopt;
+
+  char magic[sizeof(kIndexMagic)];
+  PGNIndex index;
+  uint64_t count = 0;
+  in.read(magic, sizeof(magic));
+  in.read(reinterpret_cast<char*>(&index.file_size), sizeof(index.file_size));
+  in.read(reinterpret_cast<char*>(&index.file_mtime), sizeof(index.file_mtime));
+  in.read(reinterpret_cast<char*>(&count), sizeof(count));
+  if (!in || 0 != memcmp(magic, kIndexMagic, sizeof(magic))) {
+    return std::nullopt;
+  }
+  if (index.file_size != current_file_size(pgn_file_name) ||
+      index.file_mtime != current_file_mtime(pgn_file_name)) {
+    return std::nullopt;
+  }
+  // A corrupt count must not turn into a huge allocation: the offsets have
+  // to fill the rest of the sidecar, and there is at most one game per byte
+  // of the PGN.
+  std::error_code error;
+  const uint64_t sidecar_size =
+      std::filesystem::file_size(SidecarName(pgn_file_name), error);
+  const uint64_t header_size = static_cast<uint64_t>(in.tellg());
+  if (error || sidecar_size < header_size ||
+      count != (sidecar_size - header_size) / sizeof(uint64_t) ||
+      count > index.file_size) {
+    return std::nullopt;
+  }
+  index.offsets.resize(count);
+  in.read(reinterpret_cast<char*>(index.offsets.data()),
+          count * sizeof(uint64_t));
+  if (!in) return std::nullopt;
+  for (size_t i = 0; i < index.offsets.size(); ++i) {
+    if (index.offsets[i] >= index.file_size ||
+        (i > 0 && index.offsets[i] <= index.offsets[i - 1])) {
+      return std::nullopt;
+    }
+  }
+  return index;
+}
+
+bool PGNIndex::Save(const std::string& pgn_file_name) const {
+  std::ofstream out(SidecarName(pgn_file_name), std::ios::binary);
+  uint64_t count = offsets.size();
+  out.write(kIndexMagic, sizeof(kIndexMagic));
+  out.write(reinterpret_cast<const char*>(&file_size), sizeof(file_size));
+  out.write(reinterpret_cast<const char*>(&file_mtime), sizeof(file_mtime));
+  out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+  out.write(reinterpret_cast<const char*>(offsets.data()),
+            count * sizeof(uint64_t));
+  return static_cast<bool>(out);
+}
+
+void pgn_open_at(pgn_t* pgn, const std::string& pgn_file_name,
+                 uint64_t offset) {
+  pgn_open(pgn, pgn_file_name.c_str());
+  // Nothing has been read yet, so moving the FILE* leaves polyglot's lexer
+  // state consistent; only its line numbers in error messages are off.
+  if (offset == 0) return;
+#if defined(_WIN32)
+  _fseeki64(pgn->file, static_cast<__int64>(offset), SEEK_SET);
+#else
+  fseeko(pgn->file, static_cast<off_t>(offset), SEEK_SET);
+#endif
+}
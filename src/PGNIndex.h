@@ -0,0 +1,47 @@
+#ifndef TRAININGDATA_TOOL_PGNINDEX_H
+#define TRAININGDATA_TOOL_PGNINDEX_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "pgn.h"
+
+// Half-open range [begin, end) of game numbers within one PGN file.
+struct GameRange {
+  int64_t begin = 0;
+  int64_t end = INT64_MAX;
+};
+
+// Byte offset of the first tag line ("[Event ...") of every game in a PGN
+// file. The index is stored next to the PGN as "<file>.pgnidx" and is
+// rebuilt whenever the PGN's size or modification time no longer match.
+class PGNIndex {
+ public:
+  static PGNIndex LoadOrBuild(const std::string& pgn_file_name);
+
+  size_t size() const { return offsets.size(); }
+  uint64_t offset(size_t game) const { return offsets[game]; }
+
+  // Bytes taken by the games in range, used to balance work between threads.
+  uint64_t RangeBytes(GameRange range) const;
+
+  static std::string SidecarName(const std::string& pgn_file_name);
+
+ private:
+  static PGNIndex Build(const std::string& pgn_file_name);
+  static std::optional<PGNIndex> Load(const std::string& pgn_file_name);
+  bool Save(const std::string& pgn_file_name) const;
+
+  uint64_t file_size = 0;
+  int64_t file_mtime = 0;
+  std::vector<uint64_t> offsets;
+};
+
+// Opens pgn_file_name with polyglot and positions it at byte offset, which
+// must be the start of a game as recorded by PGNIndex.
+void pgn_open_at(pgn_t* pgn, const std::string& pgn_file_name,
+                 uint64_t offset);
+
+#endif
@@ -0,0 +1,172 @@
+#include "PGNLexer.h"
+
+#include <array>
+
+#include "SimdScan.h"
+
+namespace {
+
+enum CharClass : unsigned char { kOther, kSpace, kSymbol, kDigit };
+
+constexpr std::array<unsigned char, 256> make_char_classes() {
+  std::array<unsigned char, 256> classes{};
+  for (char c : {' ', '\t', '\r', '\n', '.'}) {
+    classes[static_cast<unsigned char>(c)] = kSpace;
+  }
+  for (int c = 'a'; c <= 'z'; ++c) classes[c] = kSymbol;
+  for (int c = 'A'; c <= 'Z'; ++c) classes[c] = kSymbol;
+  for (int c = '0'; c <= '9'; ++c) classes[c] = kDigit;
+  for (char c : {'+', '#', '=', '-', '/', '!', '?', '_', ':'}) {
+    classes[static_cast<unsigned char>(c)] = kSymbol;
+  }
+  return classes;
+}
+
+constexpr std::array<unsigned char, 256> kCharClasses = make_char_classes();
+
+inline unsigned char char_class(char c) {
+  return kCharClasses[static_cast<unsigned char>(c)];
+}
+
+inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+// Returns the first byte of the line after p's line.
+inline const char* next_line(const char* p, const char* end) {
+  p = scan_for(p, end, '\n');
+  return p < end ? p + 1 : end;
+}
+
+// Returns the start of the next line that begins with '[' outside a brace
+// comment, which is where the next game's tags start.
+const char* find_movetext_end(const char* p, const char* end) {
+  while (p < end) {
+    p = scan_for_any(p, end, '\n', '{', ';');
+    if (p == end) break;
+    if (*p == '{') {
+      p = scan_for(p + 1, end, '}');
+      if (p < end) ++p;
+      continue;
+    }
+    if (*p == ';') {
+      p = scan_for(p + 1, end, '\n');
+      continue;
+    }
+    const char* line = ++p;
+    while (p < end && is_blank(*p)) ++p;
+    if (p < end && *p == '[') return line;
+  }
+  return end;
+}
+
+bool is_result(std::string_view symbol) {
+  return symbol == "1-0" || symbol == "0-1" || symbol == "1/2-1/2" ||
+         symbol == "*";
+}
+
+}  // namespace
+
+bool PGNLexer::NextGame(PGNGameText& game) {
+  while (p < end && char_class(*p) == kSpace) ++p;
+  if (p == end) return false;
+
+  // Tag section: consecutive lines starting with '['.
+  const char* tags_begin = p;
+  while (p < end && *p == '[') {
+    p = next_line(p, end);
+    while (p < end && is_blank(*p)) ++p;
+  }
+  game.tags = std::string_view(tags_begin, p - tags_begin);
+
+  const char* movetext_begin = p;
+  p = find_movetext_end(p, end);
+  game.movetext = std::string_view(movetext_begin, p - movetext_begin);
+  return true;
+}
+
+std::string_view PGNLexer::FindTag(std::string_view tags,
+                                   std::string_view name) {
+  std::string_view found;
+  ForEachTag(tags, [&](std::string_view tag, std::string_view value) {
+    if (found.empty() && tag == name) found = value;
+  });
+  return found;
+}
+
+bool PGNLexer::MoveTokenizer::Next(PGNToken& token) {
+  while (p < end) {
+    const char c = *p;
+    switch (char_class(c)) {
+      case kSpace:
+        ++p;
+        continue;
+      case kSymbol:
+      case kDigit: {
+        const char* begin = p;
+        bool digits_only = true;
+        while (p < end && char_class(*p) >= kSymbol) {
+          digits_only &= char_class(*p) == kDigit;
+          ++p;
+        }
+        std::string_view symbol(begin, p - begin);
+        if (is_result(symbol)) {
+          p = end;
+          return false;
+        }
+        // Move numbers are followed by dots, which are skipped as blanks.
+        if (digits_only) continue;
+        token = {PGNTokenType::kMove, symbol};
+        return true;
+      }
+      default:
+        break;
+    }
+    switch (c) {
+      case '{': {
+        const char* close = scan_for(p + 1, end, '}');
+        token = {PGNTokenType::kComment,
+                 std::string_view(p + 1, close - p - 1)};
+        p = close < end ? close + 1 : end;
+        return true;
+      }
+      case ';': {
+        const char* eol = scan_for(p + 1, end, '\n');
+        token = {PGNTokenType::kComment, std::string_view(p + 1, eol - p - 1)};
+        p = eol;
+        return true;
+      }
+      case '$': {
+        const char* begin = ++p;
+        while (p < end && char_class(*p) == kDigit) ++p;
+        token = {PGNTokenType::kNag, std::string_view(begin, p - begin)};
+        return true;
+      }
+      case '(':
+        SkipVariation();
+        continue;
+      case '*':
+        p = end;
+        return false;
+      default:
+        // Stray ')' or anything else that is not PGN.
+        ++p;
+        continue;
+    }
+  }
+  return false;
+}
+
+void PGNLexer::MoveTokenizer::SkipVariation() {
+  int depth = 0;
+  while (p < end) {
+    p = scan_for_any(p, end, '(', ')', '{');
+    if (p == end) return;
+    if (*p == '{') {
+      p = scan_for(p + 1, end, '}');
+      if (p < end) ++p;
+      continue;
+    }
+    depth += *p == '(' ? 1 : -1;
+    ++p;
+    if (depth == 0) return;
+  }
+}
@@ -0,0 +1,82 @@
+#ifndef TRAININGDATA_TOOL_PGNLEXER_H
+#define TRAININGDATA_TOOL_PGNLEXER_H
+
+#include <string_view>
+
+// Tag section and movetext of one game, pointing into the lexer's input.
+struct PGNGameText {
+  std::string_view tags;
+  std::string_view movetext;
+};
+
+enum class PGNTokenType { kMove, kComment, kNag };
+
+struct PGNToken {
+  PGNTokenType type;
+  // SAN as written, comment text without its delimiters, or NAG digits.
+  std::string_view text;
+};
+
+// Zero-copy PGN lexer over an in-memory buffer (usually a MappedFile).
+//
+// NextGame() only locates game boundaries; tags and movetext are tokenized on
+// demand, so a game can be looked at or skipped without touching its moves.
+// Every view stays valid for as long as the input buffer does.
+class PGNLexer {
+ public:
+  explicit PGNLexer(std::string_view input) : p(input.data()),
+      end(input.data() + input.size()) {}
+
+  // Returns false once the input is exhausted.
+  bool NextGame(PGNGameText& game);
+
+  // Calls fn(name, value) for every tag pair. Escapes in values are kept.
+  template <typename Fn>
+  static void ForEachTag(std::string_view tags, Fn&& fn);
+
+  // Returns the value of the named tag, or an empty view.
+  static std::string_view FindTag(std::string_view tags, std::string_view name);
+
+  // Tokenizes movetext. Move numbers and variations are skipped, and the
+  // game result ends the movetext.
+  class MoveTokenizer {
+   public:
+    explicit MoveTokenizer(std::string_view movetext)
+        : p(movetext.data()), end(movetext.data() + movetext.size()) {}
+    // Returns false at the end of the movetext.
+    bool Next(PGNToken& token);
+
+   private:
+    void SkipVariation();
+    const char* p;
+    const char* end;
+  };
+
+ private:
+  const char* p;
+  const char* end;
+};
+
+template <typename Fn>
+void PGNLexer::ForEachTag(std::string_view tags, Fn&& fn) {
+  size_t pos = 0;
+  while ((pos = tags.find('[', pos)) != std::string_view::npos) {
+    size_t name_begin = pos + 1;
+    size_t name_end = tags.find_first_of(" \t\"]", name_begin);
+    size_t open_quote = tags.find('"', name_begin);
+    if (name_end == std::string_view::npos ||
+        open_quote == std::string_view::npos) {
+      return;
+    }
+    size_t close_quote = open_quote + 1;
+    while (close_quote < tags.size() && tags[close_quote] != '"') {
+      close_quote += tags[close_quote] == '\\' ? 2 : 1;
+    }
+    if (close_quote >= tags.size()) return;
+    fn(tags.substr(name_begin, name_end - name_begin),
+       tags.substr(open_quote + 1, close_quote - open_quote - 1));
+    pos = close_quote + 1;
+  }
+}
+
+#endif
@@ -1,13 +1,15 @@
 #if !defined(PGN_MOVE_INFO_H_INCLUDED)
 #define PGN_MOVE_INFO_H_INCLUDED
 
-#include "pgn.h"
+#include <cstdint>
 
+// Location of one move's SAN, NAG and comment in its PGNGame's text arena.
+// The three are stored back to back starting at offset.
 struct PGNMoveInfo {
-  char move[PGN_STRING_SIZE];
-  char comment[PGN_STRING_SIZE];
-  char nag[PGN_STRING_SIZE];
-  explicit PGNMoveInfo(char* move, char* comment, char* nag);
+  uint32_t offset;
+  uint8_t move_length;
+  uint8_t nag_length;
+  uint16_t comment_length;
 };
 
 #endif
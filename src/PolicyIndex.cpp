@@ -0,0 +1,62 @@
+#include "PolicyIndex.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "neural/encoder.h"
+
+namespace {
+
+// Applies the transforms in the order MoveToNNIndex does.
+int transform_square(lczero::Square square, int transform) {
+  int file = square.file().idx;
+  int rank = square.rank().idx;
+  if (transform & lczero::FlipTransform) file = 7 - file;
+  if (transform & lczero::MirrorTransform) rank = 7 - rank;
+  // Transposes about the a8-h1 diagonal, as lc0's TransposeBitsInBytes.
+  if (transform & lczero::TransposeTransform) {
+    int new_file = 7 - rank;
+    rank = 7 - file;
+    file = new_file;
+  }
+  return rank * 8 + file;
+}
+
+}  // namespace
+
+uint16_t policy_index(lczero::Move move, int transform) {
+  if (transform == 0) return policy_index(move);
+  return kPolicyIndexTable[policy_promotion_code(move) * 4096 +
+                           transform_square(move.from(), transform) * 64 +
+                           transform_square(move.to(), transform)];
+}
+
+void fill_policy_mask(const lczero::MoveList& legal_moves,
+                      float* probabilities) {
+  std::fill(probabilities, probabilities + kPolicySize, -1.0f);
+  set_policy_legal_moves(legal_moves, probabilities);
+}
+
+void set_policy_legal_moves(const lczero::MoveList& legal_moves,
+                            float* probabilities, int transform) {
+#ifndef NDEBUG
+  for (lczero::Move move : legal_moves) {
+    if (policy_index(move, transform) !=
+        lczero::MoveToNNIndex(move, transform)) {
+      std::cerr << "Warning: policy index " << policy_index(move, transform)
+                << " of move " << move.ToString(false)
+                << " differs from MoveToNNIndex "
+                << lczero::MoveToNNIndex(move, transform) << std::endl;
+    }
+  }
+#endif
+  if (transform == 0) {
+    for (lczero::Move move : legal_moves) {
+      probabilities[policy_index(move)] = 0.0f;
+    }
+  } else {
+    for (lczero::Move move : legal_moves) {
+      probabilities[policy_index(move, transform)] = 0.0f;
+    }
+  }
+}
@@ -0,0 +1,100 @@
+#ifndef TRAININGDATA_TOOL_POLICYINDEX_H
+#define TRAININGDATA_TOOL_POLICYINDEX_H
+
+#include <array>
+#include <cstdint>
+
+#include "chess/types.h"
+
+// Number of entries in lc0's policy head.
+constexpr uint16_t kPolicySize = 1858;
+constexpr uint16_t kInvalidPolicyIndex = UINT16_MAX;
+
+namespace policy_index_detail {
+
+constexpr size_t kTableSize = 4 * 64 * 64;
+
+constexpr bool is_policy_move(int from, int to) {
+  int file_delta = to % 8 - from % 8;
+  int rank_delta = to / 8 - from / 8;
+  if (file_delta < 0) file_delta = -file_delta;
+  if (rank_delta < 0) rank_delta = -rank_delta;
+  if (from == to) return false;
+  if (file_delta == 0 || rank_delta == 0 || file_delta == rank_delta) {
+    return true;
+  }
+  return file_delta * rank_delta == 2;
+}
+
+constexpr std::array<uint16_t, kTableSize> make_table() {
+  std::array<uint16_t, kTableSize> table{};
+  for (auto& entry : table) entry = kInvalidPolicyIndex;
+  uint16_t index = 0;
+  for (int from = 0; from < 64; ++from) {
+    for (int to = 0; to < 64; ++to) {
+      if (is_policy_move(from, to)) table[from * 64 + to] = index++;
+    }
+  }
+  for (int from_file = 0; from_file < 8; ++from_file) {
+    for (int to_file = from_file - 1; to_file <= from_file + 1; ++to_file) {
+      if (to_file < 0 || to_file > 7) continue;
+      for (int promotion = 1; promotion <= 3; ++promotion) {
+        table[promotion * 4096 + (48 + from_file) * 64 + 56 + to_file] =
+            index++;
+      }
+    }
+  }
+  return table;
+}
+
+}  // namespace policy_index_detail
+
+// Policy index of every (promotion, from, to) triple, indexed by
+// promotion * 4096 + from * 64 + to. Promotion 0 is a plain move or a knight
+// promotion, which share an index in lc0; 1, 2 and 3 are promotions to a
+// queen, rook and bishop. Castling is the king taking its own rook.
+//
+// The layout is that of lc0's policy: 1792 queen and knight moves ordered by
+// from square and then to square, followed by the 66 promotions ordered by
+// from file, to file and then queen, rook, bishop.
+inline constexpr std::array<uint16_t, policy_index_detail::kTableSize>
+    kPolicyIndexTable = policy_index_detail::make_table();
+
+// Spot checks against lc0's move list.
+static_assert(kPolicyIndexTable[0 * 64 + 1] == 0, "a1b1");
+static_assert(kPolicyIndexTable[63 * 64 + 62] == 1791, "h8g8");
+static_assert(kPolicyIndexTable[1 * 4096 + 48 * 64 + 56] == 1792, "a7a8q");
+static_assert(kPolicyIndexTable[3 * 4096 + 55 * 64 + 63] == 1857, "h7h8b");
+
+// The promotion part of a kPolicyIndexTable index, computed without
+// branches.
+inline int policy_promotion_code(lczero::Move move) {
+  const lczero::PieceType promotion = move.promotion();
+  return move.is_promotion() * ((promotion == lczero::kQueen) +
+                                2 * (promotion == lczero::kRook) +
+                                3 * (promotion == lczero::kBishop));
+}
+
+// Policy index of a move relative to the side to move, without any
+// transform, as lczero::MoveToNNIndex(move, 0).
+inline uint16_t policy_index(lczero::Move move) {
+  return kPolicyIndexTable[policy_promotion_code(move) * 4096 +
+                           move.from().as_idx() * 64 + move.to().as_idx()];
+}
+
+// Policy index of a move under one of lc0's board transforms (a combination
+// of FlipTransform, MirrorTransform and TransposeTransform), as
+// lczero::MoveToNNIndex(move, transform).
+uint16_t policy_index(lczero::Move move, int transform);
+
+// Sets probabilities to -1 for illegal moves and 0 for every legal move.
+// probabilities must hold kPolicySize entries.
+void fill_policy_mask(const lczero::MoveList& legal_moves,
+                      float* probabilities);
+
+// Like fill_policy_mask for probabilities already set to -1 everywhere, as in
+// v6_template_record(): only the legal moves are written.
+void set_policy_legal_moves(const lczero::MoveList& legal_moves,
+                            float* probabilities, int transform = 0);
+
+#endif
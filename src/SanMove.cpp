@@ -0,0 +1,153 @@
+#include "SanMove.h"
+
+#include <cstring>
+
+namespace {
+
+bool is_blank(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+bool is_file(char c) { return c >= 'a' && c <= 'h'; }
+bool is_rank(char c) { return c >= '1' && c <= '8'; }
+
+bool piece_from_letter(char c, lczero::PieceType& piece) {
+  switch (c) {
+    case 'N':
+      piece = lczero::kKnight;
+      return true;
+    case 'B':
+      piece = lczero::kBishop;
+      return true;
+    case 'R':
+      piece = lczero::kRook;
+      return true;
+    case 'Q':
+      piece = lczero::kQueen;
+      return true;
+    case 'K':
+      piece = lczero::kKing;
+      return true;
+  }
+  return false;
+}
+
+lczero::PieceType piece_on(const lczero::ChessBoard& board,
+                           lczero::Square square) {
+  if (board.pawns().get(square)) return lczero::kPawn;
+  if (board.knights().get(square)) return lczero::kKnight;
+  if (board.bishops().get(square)) return lczero::kBishop;
+  if (board.rooks().get(square)) return lczero::kRook;
+  if (board.queens().get(square)) return lczero::kQueen;
+  return lczero::kKing;
+}
+
+bool resolve_castling(bool kingside, const lczero::MoveList& legal_moves,
+                      lczero::Move& move) {
+  for (lczero::Move m : legal_moves) {
+    if (!m.is_castling()) continue;
+    // lc0 encodes castling as the king capturing its own rook.
+    if ((m.to().file().idx > m.from().file().idx) == kingside) {
+      move = m;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+bool normalize_san(std::string_view raw, SanBuffer& san) {
+  san.length = 0;
+  while (!raw.empty() && is_blank(raw.front())) raw.remove_prefix(1);
+  while (!raw.empty() && is_blank(raw.back())) raw.remove_suffix(1);
+
+  size_t digits = 0;
+  while (digits < raw.size() && is_digit(raw[digits])) ++digits;
+  if (digits < raw.size() && raw[digits] == '.') {
+    raw.remove_prefix(digits);
+    while (!raw.empty() && (raw.front() == '.' || is_blank(raw.front()))) {
+      raw.remove_prefix(1);
+    }
+  }
+
+  raw = raw.substr(0, raw.find('{'));
+  while (!raw.empty() && is_blank(raw.back())) raw.remove_suffix(1);
+  while (!raw.empty() && std::strchr("!?+#=", raw.back()) != nullptr) {
+    raw.remove_suffix(1);
+  }
+  if (!raw.empty() && raw.back() == '.') raw.remove_suffix(1);
+
+  if (raw.empty() || raw.size() > SanBuffer::kCapacity) return false;
+  std::memcpy(san.text, raw.data(), raw.size());
+  san.length = static_cast<uint8_t>(raw.size());
+  return true;
+}
+
+bool resolve_san(std::string_view san, const lczero::ChessBoard& board,
+                 const lczero::MoveList& legal_moves, bool is_black_move,
+                 lczero::Move& move) {
+  if (san == "O-O" || san == "0-0") {
+    return resolve_castling(true, legal_moves, move);
+  }
+  if (san == "O-O-O" || san == "0-0-0") {
+    return resolve_castling(false, legal_moves, move);
+  }
+
+  lczero::PieceType piece = lczero::kPawn;
+  if (!san.empty() && piece_from_letter(san.front(), piece)) {
+    san.remove_prefix(1);
+  }
+
+  bool has_promotion = false;
+  lczero::PieceType promotion = lczero::kQueen;
+  if (piece == lczero::kPawn && !san.empty() &&
+      piece_from_letter(san.back(), promotion)) {
+    has_promotion = promotion != lczero::kKing;
+    if (!has_promotion) return false;
+    san.remove_suffix(1);
+    if (!san.empty() && san.back() == '=') san.remove_suffix(1);
+  }
+
+  // What is left are squares, optionally separated by 'x', '-' or ':'. The
+  // last file/rank pair is the destination, anything before disambiguates.
+  char coords[4];
+  size_t count = 0;
+  for (char c : san) {
+    if (c == 'x' || c == '-' || c == ':') continue;
+    if ((!is_file(c) && !is_rank(c)) || count == sizeof(coords)) return false;
+    coords[count++] = c;
+  }
+  if (count < 2 || !is_file(coords[count - 2]) || !is_rank(coords[count - 1])) {
+    return false;
+  }
+  auto board_rank = [is_black_move](char c) {
+    int rank = c - '1';
+    return is_black_move ? 7 - rank : rank;
+  };
+  const lczero::Square to = lczero::Square::FromIdx(
+      board_rank(coords[count - 1]) * 8 + (coords[count - 2] - 'a'));
+  int from_file = -1;
+  int from_rank = -1;
+  for (size_t i = 0; i + 2 < count; ++i) {
+    if (is_file(coords[i])) {
+      from_file = coords[i] - 'a';
+    } else {
+      from_rank = board_rank(coords[i]);
+    }
+  }
+
+  size_t matches = 0;
+  for (lczero::Move m : legal_moves) {
+    if (m.is_castling() || !(m.to() == to)) continue;
+    if (from_file >= 0 && m.from().file().idx != from_file) continue;
+    if (from_rank >= 0 && m.from().rank().idx != from_rank) continue;
+    if (!(piece_on(board, m.from()) == piece)) continue;
+    if (m.is_promotion() && !(m.promotion() == promotion)) continue;
+    if (!m.is_promotion() && has_promotion) return false;
+    move = m;
+    ++matches;
+  }
+  return matches == 1;
+}
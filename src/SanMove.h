@@ -0,0 +1,33 @@
+#ifndef TRAININGDATA_TOOL_SANMOVE_H
+#define TRAININGDATA_TOOL_SANMOVE_H
+
+#include <cstdint>
+#include <string_view>
+
+#include "chess/board.h"
+
+// Normalized SAN, held in a fixed buffer so that no move allocates.
+struct SanBuffer {
+  // Longer than any legal SAN such as "Qh4xe1+" or "exd8=Q#".
+  static constexpr size_t kCapacity = 16;
+  char text[kCapacity];
+  uint8_t length = 0;
+
+  std::string_view view() const { return {text, length}; }
+};
+
+// Cleans a SAN token as written in a PGN: trims blanks, drops a leading move
+// number ("12." or "12..."), anything from a '{' on, and trailing "!?+#="
+// and '.'. Returns false if nothing is left or the result does not fit.
+bool normalize_san(std::string_view raw, SanBuffer& san);
+
+// Finds the move in legal_moves that san denotes. board and legal_moves are
+// in lc0's side-to-move orientation, so for black the SAN squares are
+// mirrored before matching. A pawn move to the last rank without a
+// promotion piece is taken as a queen promotion. Returns false if no legal
+// move or more than one matches.
+bool resolve_san(std::string_view san, const lczero::ChessBoard& board,
+                 const lczero::MoveList& legal_moves, bool is_black_move,
+                 lczero::Move& move);
+
+#endif
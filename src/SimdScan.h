@@ -0,0 +1,42 @@
+#ifndef TRAININGDATA_TOOL_SIMDSCAN_H
+#define TRAININGDATA_TOOL_SIMDSCAN_H
+
+#include <bit>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define TRAININGDATA_TOOL_SSE2
+#endif
+
+// Byte scanning helpers for the PGN lexer. Each returns a pointer to the first
+// matching byte in [p, end), or end if there is none. Sixteen bytes are tested
+// per step with SSE2 where available, with a scalar loop for the tail.
+
+inline const char* scan_for(const char* p, const char* end, char c) {
+  const void* found = memchr(p, c, end - p);
+  return found ? static_cast<const char*>(found) : end;
+}
+
+inline const char* scan_for_any(const char* p, const char* end, char a,
+                                char b, char c) {
+#if defined(TRAININGDATA_TOOL_SSE2)
+  const __m128i va = _mm_set1_epi8(a);
+  const __m128i vb = _mm_set1_epi8(b);
+  const __m128i vc = _mm_set1_epi8(c);
+  for (; end - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i hits = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)),
+        _mm_cmpeq_epi8(v, vc));
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+    if (mask != 0) return p + std::countr_zero(mask);
+  }
+#endif
+  for (; p < end; ++p) {
+    if (*p == a || *p == b || *p == c) return p;
+  }
+  return end;
+}
+
+#endif
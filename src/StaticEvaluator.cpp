@@ -2,8 +2,8 @@
 #include <cmath>
 #include <algorithm>
 
-// Piece-Square Tables (from white's perspective, index 0 = a1, index 63 = h8)
-// Values in centipawns, positive = good for white
+// Piece-Square Tables (from white's perspective, index 0 = a8, index 63 = h1,
+// as laid out below). Values in centipawns, positive = good for white
 
 // Pawns: encourage central control and advancement
 const int StaticEvaluator::PST_PAWN[64] = {
@@ -95,251 +95,211 @@ float StaticEvaluator::cpToWinProbability(int cp) {
   return 2.0f / (1.0f + std::exp(-0.004f * cp)) - 1.0f;
 }
 
-int StaticEvaluator::getPhase(board_t* board) {
+namespace {
+
+// Table index of a square for our pieces. Tables are laid out with rank 8
+// first, so our side's squares are mirrored and theirs are used as is.
+int our_index(lczero::Square sq) { return sq.as_idx() ^ 56; }
+int their_index(lczero::Square sq) { return sq.as_idx(); }
+
+}  // namespace
+
+int StaticEvaluator::getPhase(const lczero::ChessBoard& board) {
   // Phase: 24 = opening, 0 = endgame
   // Each minor = 1, each rook = 2, each queen = 4
-  int phase = 0;
-  
-  for (int sq = 0; sq < 64; sq++) {
-    int piece = board->square[sq];
-    if (piece == WhiteKnight12 || piece == BlackKnight12) phase += 1;
-    if (piece == WhiteBishop12 || piece == BlackBishop12) phase += 1;
-    if (piece == WhiteRook12 || piece == BlackRook12) phase += 2;
-    if (piece == WhiteQueen12 || piece == BlackQueen12) phase += 4;
-  }
-  
+  int phase = board.knights().count() + board.bishops().count() +
+              2 * board.rooks().count() + 4 * board.queens().count();
   return std::min(phase, 24);
 }
 
-int StaticEvaluator::evaluateMaterial(board_t* board) {
+int StaticEvaluator::evaluateMaterial(const lczero::ChessBoard& board) {
+  const lczero::BitBoard ours = board.ours();
+  const lczero::BitBoard theirs = board.theirs();
   int score = 0;
-  int whiteBishops = 0, blackBishops = 0;
-  
-  for (int sq = 0; sq < 64; sq++) {
-    int piece = board->square[sq];
-    switch (piece) {
-      case WhitePawn12:   score += PAWN_VALUE; break;
-      case BlackPawn12:   score -= PAWN_VALUE; break;
-      case WhiteKnight12: score += KNIGHT_VALUE; break;
-      case BlackKnight12: score -= KNIGHT_VALUE; break;
-      case WhiteBishop12: score += BISHOP_VALUE; whiteBishops++; break;
-      case BlackBishop12: score -= BISHOP_VALUE; blackBishops++; break;
-      case WhiteRook12:   score += ROOK_VALUE; break;
-      case BlackRook12:   score -= ROOK_VALUE; break;
-      case WhiteQueen12:  score += QUEEN_VALUE; break;
-      case BlackQueen12:  score -= QUEEN_VALUE; break;
-    }
-  }
-  
+
+  score += PAWN_VALUE * ((ours & board.pawns()).count() -
+                         (theirs & board.pawns()).count());
+  score += KNIGHT_VALUE * ((ours & board.knights()).count() -
+                           (theirs & board.knights()).count());
+  int ourBishops = (ours & board.bishops()).count();
+  int theirBishops = (theirs & board.bishops()).count();
+  score += BISHOP_VALUE * (ourBishops - theirBishops);
+  score += ROOK_VALUE * ((ours & board.rooks()).count() -
+                         (theirs & board.rooks()).count());
+  score += QUEEN_VALUE * ((ours & board.queens()).count() -
+                          (theirs & board.queens()).count());
+
   // Bishop pair bonus
-  if (whiteBishops >= 2) score += BISHOP_PAIR_BONUS;
-  if (blackBishops >= 2) score -= BISHOP_PAIR_BONUS;
-  
+  if (ourBishops >= 2) score += BISHOP_PAIR_BONUS;
+  if (theirBishops >= 2) score -= BISHOP_PAIR_BONUS;
+
   return score;
 }
 
-int StaticEvaluator::evaluatePST(board_t* board, int phase) {
+int StaticEvaluator::evaluatePST(const lczero::ChessBoard& board, int phase) {
+  const lczero::BitBoard ours = board.ours();
+  const lczero::BitBoard theirs = board.theirs();
   int scoreMG = 0, scoreEG = 0;
-  
-  for (int sq = 0; sq < 64; sq++) {
-    int piece = board->square[sq];
-    int whiteSq = sq;           // For white pieces
-    int blackSq = sq ^ 56;      // Flip for black (mirror vertically)
-    
-    switch (piece) {
-      case WhitePawn12:
-        scoreMG += PST_PAWN[whiteSq];
-        scoreEG += PST_PAWN[whiteSq];
-        break;
-      case BlackPawn12:
-        scoreMG -= PST_PAWN[blackSq];
-        scoreEG -= PST_PAWN[blackSq];
-        break;
-      case WhiteKnight12:
-        scoreMG += PST_KNIGHT[whiteSq];
-        scoreEG += PST_KNIGHT[whiteSq];
-        break;
-      case BlackKnight12:
-        scoreMG -= PST_KNIGHT[blackSq];
-        scoreEG -= PST_KNIGHT[blackSq];
-        break;
-      case WhiteBishop12:
-        scoreMG += PST_BISHOP[whiteSq];
-        scoreEG += PST_BISHOP[whiteSq];
-        break;
-      case BlackBishop12:
-        scoreMG -= PST_BISHOP[blackSq];
-        scoreEG -= PST_BISHOP[blackSq];
-        break;
-      case WhiteRook12:
-        scoreMG += PST_ROOK[whiteSq];
-        scoreEG += PST_ROOK[whiteSq];
-        break;
-      case BlackRook12:
-        scoreMG -= PST_ROOK[blackSq];
-        scoreEG -= PST_ROOK[blackSq];
-        break;
-      case WhiteQueen12:
-        scoreMG += PST_QUEEN[whiteSq];
-        scoreEG += PST_QUEEN[whiteSq];
-        break;
-      case BlackQueen12:
-        scoreMG -= PST_QUEEN[blackSq];
-        scoreEG -= PST_QUEEN[blackSq];
-        break;
-      case WhiteKing12:
-        scoreMG += PST_KING_MG[whiteSq];
-        scoreEG += PST_KING_EG[whiteSq];
-        break;
-      case BlackKing12:
-        scoreMG -= PST_KING_MG[blackSq];
-        scoreEG -= PST_KING_EG[blackSq];
-        break;
+
+  // Pieces whose table is the same in the middlegame and the endgame.
+  const struct {
+    lczero::BitBoard pieces;
+    const int* table;
+  } tables[] = {{board.pawns(), PST_PAWN},
+                {board.knights(), PST_KNIGHT},
+                {board.bishops(), PST_BISHOP},
+                {board.rooks(), PST_ROOK},
+                {board.queens(), PST_QUEEN}};
+  for (const auto& t : tables) {
+    for (auto sq : ours & t.pieces) {
+      scoreMG += t.table[our_index(sq)];
+      scoreEG += t.table[our_index(sq)];
     }
+    for (auto sq : theirs & t.pieces) {
+      scoreMG -= t.table[their_index(sq)];
+      scoreEG -= t.table[their_index(sq)];
+    }
+  }
+  for (auto sq : ours & board.kings()) {
+    scoreMG += PST_KING_MG[our_index(sq)];
+    scoreEG += PST_KING_EG[our_index(sq)];
+  }
+  for (auto sq : theirs & board.kings()) {
+    scoreMG -= PST_KING_MG[their_index(sq)];
+    scoreEG -= PST_KING_EG[their_index(sq)];
   }
-  
+
   // Tapered evaluation
   int mgWeight = phase;
   int egWeight = 24 - phase;
   return (scoreMG * mgWeight + scoreEG * egWeight) / 24;
 }
 
-int StaticEvaluator::evaluatePawnStructure(board_t* board) {
+int StaticEvaluator::evaluatePawnStructure(const lczero::ChessBoard& board) {
   int score = 0;
-  
-  // Count pawns per file
-  int whitePawnsPerFile[8] = {0};
-  int blackPawnsPerFile[8] = {0};
-  int whitePawnRanks[8] = {0};  // Most advanced white pawn per file
-  int blackPawnRanks[8] = {7};  // Most advanced black pawn per file
-  
-  for (int sq = 0; sq < 64; sq++) {
-    int file = sq % 8;
-    int rank = sq / 8;
-    int piece = board->square[sq];
-    
-    if (piece == WhitePawn12) {
-      whitePawnsPerFile[file]++;
-      whitePawnRanks[file] = std::max(whitePawnRanks[file], rank);
-    } else if (piece == BlackPawn12) {
-      blackPawnsPerFile[file]++;
-      blackPawnRanks[file] = std::min(blackPawnRanks[file], rank);
-    }
+
+  // Count pawns per file. Our pawns move up the board, theirs down.
+  int ourPawnsPerFile[8] = {0};
+  int theirPawnsPerFile[8] = {0};
+  int ourMostAdvanced[8], ourRearmost[8];
+  int theirMostAdvanced[8], theirRearmost[8];
+  for (int file = 0; file < 8; file++) {
+    ourMostAdvanced[file] = -1;
+    ourRearmost[file] = 8;
+    theirMostAdvanced[file] = 8;
+    theirRearmost[file] = -1;
+  }
+
+  for (auto sq : board.ours() & board.pawns()) {
+    int file = sq.file().idx;
+    int rank = sq.rank().idx;
+    ourPawnsPerFile[file]++;
+    ourMostAdvanced[file] = std::max(ourMostAdvanced[file], rank);
+    ourRearmost[file] = std::min(ourRearmost[file], rank);
   }
-  
+  for (auto sq : board.theirs() & board.pawns()) {
+    int file = sq.file().idx;
+    int rank = sq.rank().idx;
+    theirPawnsPerFile[file]++;
+    theirMostAdvanced[file] = std::min(theirMostAdvanced[file], rank);
+    theirRearmost[file] = std::max(theirRearmost[file], rank);
+  }
+
   for (int file = 0; file < 8; file++) {
     // Doubled pawns
-    if (whitePawnsPerFile[file] > 1) {
-      score += DOUBLED_PAWN_PENALTY * (whitePawnsPerFile[file] - 1);
+    if (ourPawnsPerFile[file] > 1) {
+      score += DOUBLED_PAWN_PENALTY * (ourPawnsPerFile[file] - 1);
     }
-    if (blackPawnsPerFile[file] > 1) {
-      score -= DOUBLED_PAWN_PENALTY * (blackPawnsPerFile[file] - 1);
+    if (theirPawnsPerFile[file] > 1) {
+      score -= DOUBLED_PAWN_PENALTY * (theirPawnsPerFile[file] - 1);
     }
-    
+
     // Isolated pawns
-    bool whiteHasNeighbor = (file > 0 && whitePawnsPerFile[file-1] > 0) ||
-                            (file < 7 && whitePawnsPerFile[file+1] > 0);
-    bool blackHasNeighbor = (file > 0 && blackPawnsPerFile[file-1] > 0) ||
-                            (file < 7 && blackPawnsPerFile[file+1] > 0);
-    
-    if (whitePawnsPerFile[file] > 0 && !whiteHasNeighbor) {
+    bool ourHasNeighbor = (file > 0 && ourPawnsPerFile[file-1] > 0) ||
+                          (file < 7 && ourPawnsPerFile[file+1] > 0);
+    bool theirHasNeighbor = (file > 0 && theirPawnsPerFile[file-1] > 0) ||
+                            (file < 7 && theirPawnsPerFile[file+1] > 0);
+
+    if (ourPawnsPerFile[file] > 0 && !ourHasNeighbor) {
       score += ISOLATED_PAWN_PENALTY;
     }
-    if (blackPawnsPerFile[file] > 0 && !blackHasNeighbor) {
+    if (theirPawnsPerFile[file] > 0 && !theirHasNeighbor) {
       score -= ISOLATED_PAWN_PENALTY;
     }
-    
+
     // Passed pawns (no enemy pawns on same or adjacent files ahead)
-    if (whitePawnsPerFile[file] > 0) {
+    if (ourPawnsPerFile[file] > 0) {
       bool passed = true;
       for (int f = std::max(0, file-1); f <= std::min(7, file+1); f++) {
-        if (blackPawnRanks[f] > whitePawnRanks[file]) {
+        if (theirRearmost[f] > ourMostAdvanced[file]) {
           passed = false;
           break;
         }
       }
       if (passed) {
         // Bonus based on how advanced
-        score += PASSED_PAWN_BONUS_BASE + (whitePawnRanks[file] - 1) * 10;
+        score += PASSED_PAWN_BONUS_BASE + (ourMostAdvanced[file] - 1) * 10;
       }
     }
-    
-    if (blackPawnsPerFile[file] > 0) {
+
+    if (theirPawnsPerFile[file] > 0) {
       bool passed = true;
       for (int f = std::max(0, file-1); f <= std::min(7, file+1); f++) {
-        if (whitePawnRanks[f] < blackPawnRanks[file]) {
+        if (ourRearmost[f] < theirMostAdvanced[file]) {
           passed = false;
           break;
         }
       }
       if (passed) {
-        // Bonus based on how advanced (from black's perspective)
-        score -= PASSED_PAWN_BONUS_BASE + (6 - blackPawnRanks[file]) * 10;
+        // Bonus based on how advanced (from their perspective)
+        score -= PASSED_PAWN_BONUS_BASE + (6 - theirMostAdvanced[file]) * 10;
       }
     }
   }
-  
+
   return score;
 }
 
-int StaticEvaluator::evaluateMobility(board_t* board) {
-  // Simplified mobility: count legal moves
-  // This is a rough approximation - just count attack squares
+int StaticEvaluator::evaluateMobility(const lczero::ChessBoard& board) {
+  // Simplified mobility: no move generation, just a fixed bonus per piece
+  // type, reduced for knights on the edge.
+  const lczero::BitBoard ours = board.ours();
+  const lczero::BitBoard theirs = board.theirs();
   int score = 0;
-  
-  // Count piece mobility (simplified - just based on piece presence)
-  for (int sq = 0; sq < 64; sq++) {
-    int piece = board->square[sq];
-    int file = sq % 8;
-    int rank = sq / 8;
-    
-    // Knights: up to 8 moves, bonus for central position
-    if (piece == WhiteKnight12) {
-      int mobility = 8;
-      if (file == 0 || file == 7) mobility -= 2;
-      if (rank == 0 || rank == 7) mobility -= 2;
-      score += mobility * MOBILITY_BONUS / 2;
-    } else if (piece == BlackKnight12) {
-      int mobility = 8;
-      if (file == 0 || file == 7) mobility -= 2;
-      if (rank == 0 || rank == 7) mobility -= 2;
-      score -= mobility * MOBILITY_BONUS / 2;
-    }
-    
-    // Bishops: bonus for open diagonals (simplified)
-    if (piece == WhiteBishop12) {
-      score += 5 * MOBILITY_BONUS / 2;
-    } else if (piece == BlackBishop12) {
-      score -= 5 * MOBILITY_BONUS / 2;
-    }
-    
-    // Rooks: bonus for open files (simplified)
-    if (piece == WhiteRook12) {
-      score += 4 * MOBILITY_BONUS / 2;
-    } else if (piece == BlackRook12) {
-      score -= 4 * MOBILITY_BONUS / 2;
-    }
-    
-    // Queens: large mobility bonus
-    if (piece == WhiteQueen12) {
-      score += 8 * MOBILITY_BONUS / 2;
-    } else if (piece == BlackQueen12) {
-      score -= 8 * MOBILITY_BONUS / 2;
-    }
-  }
-  
+
+  auto knight_mobility = [](lczero::Square sq) {
+    int file = sq.file().idx;
+    int rank = sq.rank().idx;
+    int mobility = 8;
+    if (file == 0 || file == 7) mobility -= 2;
+    if (rank == 0 || rank == 7) mobility -= 2;
+    return mobility * MOBILITY_BONUS / 2;
+  };
+  for (auto sq : ours & board.knights()) score += knight_mobility(sq);
+  for (auto sq : theirs & board.knights()) score -= knight_mobility(sq);
+
+  // Bishops, rooks and queens: flat bonus for their usual scope
+  score += 5 * MOBILITY_BONUS / 2 *
+           ((ours & board.bishops()).count() -
+            (theirs & board.bishops()).count());
+  score += 4 * MOBILITY_BONUS / 2 *
+           ((ours & board.rooks()).count() - (theirs & board.rooks()).count());
+  score += 8 * MOBILITY_BONUS / 2 *
+           ((ours & board.queens()).count() -
+            (theirs & board.queens()).count());
+
   return score;
 }
 
-int StaticEvaluator::evaluate(board_t* board) {
+int StaticEvaluator::evaluate(const lczero::ChessBoard& board) {
   int phase = getPhase(board);
-  
+
   int score = 0;
   score += evaluateMaterial(board);
   score += evaluatePST(board, phase);
   score += evaluatePawnStructure(board);
   score += evaluateMobility(board);
-  
-  // Return from side-to-move perspective
-  return colour_is_white(board->turn) ? score : -score;
+
+  // Already from side-to-move perspective
+  return score;
 }
@@ -1,7 +1,7 @@
 #ifndef STATIC_EVALUATOR_H
 #define STATIC_EVALUATOR_H
 
-#include "polyglot_lib.h"
+#include "chess/board.h"
 #include <cstdint>
 
 // Static position evaluator for normal mode (no engine)
@@ -9,8 +9,10 @@
 
 class StaticEvaluator {
 public:
-  // Evaluate position, returns centipawns from side-to-move perspective
-  static int evaluate(board_t* board);
+  // Evaluate position, returns centipawns from side-to-move perspective.
+  // lc0 keeps the board from the side to move's point of view, so "ours"
+  // are scored as white and no final flip is needed.
+  static int evaluate(const lczero::ChessBoard& board);
   
   // Convert centipawns to win probability in [-1, 1] range
   static float cpToWinProbability(int cp);
@@ -30,7 +32,8 @@ private:
   static constexpr int PASSED_PAWN_BONUS_BASE = 20;
   static constexpr int MOBILITY_BONUS = 4;
   
-  // Piece-Square Tables (from white's perspective, index 0 = a1)
+  // Piece-Square Tables (from white's perspective, laid out as seen from
+  // white: index 0 = a8, index 63 = h1)
   static const int PST_PAWN[64];
   static const int PST_KNIGHT[64];
   static const int PST_BISHOP[64];
@@ -39,11 +42,11 @@ private:
   static const int PST_KING_MG[64];
   static const int PST_KING_EG[64];
   
-  static int evaluateMaterial(board_t* board);
-  static int evaluatePST(board_t* board, int phase);
-  static int evaluatePawnStructure(board_t* board);
-  static int evaluateMobility(board_t* board);
-  static int getPhase(board_t* board);
+  static int evaluateMaterial(const lczero::ChessBoard& board);
+  static int evaluatePST(const lczero::ChessBoard& board, int phase);
+  static int evaluatePawnStructure(const lczero::ChessBoard& board);
+  static int evaluateMobility(const lczero::ChessBoard& board);
+  static int getPhase(const lczero::ChessBoard& board);
 };
 
 #endif // STATIC_EVALUATOR_H
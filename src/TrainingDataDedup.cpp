@@ -1,9 +1,10 @@
 #include "TrainingDataDedup.h"
 
+#include "DedupTable.h"
 #include "V6TrainingDataHashUtil.h"
 
 #include <iostream>
-#include <unordered_map>
+#include <vector>
 
 float merge_val(float old_val, size_t old_count, float new_val) {
   return (old_val * old_count + new_val) / static_cast<float>(old_count + 1);
@@ -22,12 +23,11 @@ void merge_chunks(lczero::V6TrainingData& chunk, size_t old_count,
   chunk.root_d = merge_val(chunk.root_d, old_count, new_chunk.root_d);
 }
 
-void flush(TrainingDataWriter& writer,
-           std::unordered_map<lczero::V6TrainingData, size_t>& chunk_map,
+void flush(TrainingDataWriter& writer, DedupTable& table,
            size_t& unique_count, size_t& total_count) {
   std::cout << "Start writing chunks..." << std::endl;
-  writer.EnqueueChunks(chunk_map);
-  chunk_map.clear();
+  writer.EnqueueChunks(table.records());
+  table.Clear();
   writer.Finalize();
   std::cout << "Total positions: " << total_count
             << ", unique positions: " << unique_count << ", repeated: "
@@ -44,30 +44,36 @@ void training_data_dedup(TrainingDataReader& reader, TrainingDataWriter& writer,
                          const float q_ratio) {
   size_t unique_count = 0;
   size_t total_count = 0;
-  std::unordered_map<lczero::V6TrainingData, size_t> chunk_map;
+  DedupTable table(dedup_uniq_buffersize);
 
-  while (auto new_chunk = reader.ReadChunk()) {
-    total_count++;
+  // Records are read in batches into this buffer, about 2 MB.
+  std::vector<lczero::V6TrainingData> batch(256);
+  while (size_t batch_size = reader.ReadChunks(batch)) {
+    for (size_t i = 0; i < batch_size; ++i) {
+      lczero::V6TrainingData* new_chunk = &batch[i];
+      total_count++;
 
-    // Average Z and Q depending on q_ratio
-    auto Z = new_chunk->result_q;
-    new_chunk->best_q = new_chunk->best_q * q_ratio + Z * (1.0f - q_ratio);
-    new_chunk->root_q = new_chunk->root_q * q_ratio + Z * (1.0f - q_ratio);
+      // Average Z and Q depending on q_ratio
+      auto Z = new_chunk->result_q;
+      new_chunk->best_q = new_chunk->best_q * q_ratio + Z * (1.0f - q_ratio);
+      new_chunk->root_q = new_chunk->root_q * q_ratio + Z * (1.0f - q_ratio);
 
-    auto elem = chunk_map.find(*new_chunk);
-    if (elem == chunk_map.end()) {
-      chunk_map.emplace(*new_chunk, 1);
-      unique_count++;
-    } else {
-      lczero::V6TrainingData merged = elem->first;
-      size_t old_count = elem->second;
-      merge_chunks(merged, elem->second, *new_chunk);
-      chunk_map.erase(elem);
-      chunk_map.emplace(merged, old_count + 1);
-    }
-    if (unique_count >= dedup_uniq_buffersize) {
-      flush(writer, chunk_map, unique_count, total_count);
+      bool added;
+      size_t index = table.FindOrAdd(*new_chunk, added);
+      if (added) {
+        unique_count++;
+      } else {
+        merge_chunks(table.record(index), table.count(index), *new_chunk);
+      }
+      table.count(index)++;
+      if (unique_count >= dedup_uniq_buffersize) {
+        flush(writer, table, unique_count, total_count);
+      }
     }
   }
-  flush(writer, chunk_map, unique_count, total_count);
+  flush(writer, table, unique_count, total_count);
+  if (reader.truncated_files() > 0) {
+    std::cout << reader.truncated_files()
+              << " input files were truncated or corrupt." << std::endl;
+  }
 }
\ No newline at end of file
@@ -1,48 +1,180 @@
 #include <algorithm>
-#include <filesystem>
 #include <iostream>
 
+#include "ChunkPack.h"
 #include "TrainingDataReader.h"
 
-TrainingDataReader::TrainingDataReader(const std::string& in_directory)
-    : in_files(), file(nullptr) {
-  for (auto& p : std::filesystem::directory_iterator(in_directory)) {
-    in_files.push_back(p.path().string());
+TrainingDataReader::TrainingDataReader(InputFiles in_files,
+                                       size_t read_buffer_size,
+                                       size_t read_threads,
+                                       size_t prefetch_files)
+    : in_files(std::move(in_files)),
+      file(nullptr),
+      read_buffer_size(read_buffer_size) {
+  if (read_threads > 0) {
+    if (0 == prefetch_files) prefetch_files = 2 * read_threads;
+    slots.resize(std::max(prefetch_files, read_threads));
+    for (size_t i = 0; i < read_threads; ++i) {
+      threads.emplace_back([this] { PrefetchFiles(); });
+    }
   }
-  std::sort(in_files.begin(), in_files.end());
-  in_files_it = in_files.begin();
 }
 
 TrainingDataReader::~TrainingDataReader() {
-  if (nullptr != file) {
-    gzclose(file);
+  {
+    std::lock_guard<std::mutex> lock(slots_mutex);
+    stopping = true;
+    for (auto& slot : slots) {
+      if (slot) slot->Close();
+    }
+  }
+  slot_free.notify_all();
+  for (auto& thread : threads) thread.join();
+}
+
+size_t TrainingDataReader::ReadChunks(
+    std::span<lczero::V6TrainingData> chunks) {
+  if (!threads.empty()) return ReadPrefetched(chunks);
+  size_t records = 0;
+  while (records < chunks.size()) {
+    ChunkFileReader* currentFile = getCurrentFile();
+    if (nullptr == currentFile) break;
+    bool end;
+    records += ReadRecords(*currentFile, file_name, chunks.subspan(records),
+                           end);
+    if (end) file.reset();
   }
+  return records;
 }
 
 std::optional<lczero::V6TrainingData> TrainingDataReader::ReadChunk() {
-  const size_t length = sizeof(lczero::V6TrainingData);
-  lczero::V6TrainingData buffer{};
-  int bytes_read;
-  do {
-    gzFile currentFile = getCurrentFile();
-    if (nullptr == currentFile) {
-      return std::nullopt;
-    }
-    bytes_read = gzread(currentFile, &buffer, length);
-  } while (length != bytes_read);
-  return std::optional<lczero::V6TrainingData>{buffer};
-}
-gzFile TrainingDataReader::getCurrentFile() {
-  if (nullptr != file && gzeof(file)) {
-    gzclose(file);
-    file = nullptr;
-  }
-  if (nullptr == file) {
-    if (in_files_it == in_files.end()) {
+  lczero::V6TrainingData chunk;
+  if (ReadChunks({&chunk, 1}) == 0) return std::nullopt;
+  return chunk;
+}
+
+std::unique_ptr<ChunkFileReader> TrainingDataReader::OpenFile(
+    const std::string& name) const {
+  auto reader = is_pack_file(name)
+                    ? open_pack(name)
+                    : codec_for_file(name)->Open(name, read_buffer_size);
+  if (nullptr == reader) {
+    std::cerr << "Could not open '" << name << "'" << std::endl;
+  }
+  return reader;
+}
+
+size_t TrainingDataReader::ReadRecords(
+    ChunkFileReader& file, const std::string& name,
+    std::span<lczero::V6TrainingData> chunks, bool& end) {
+  const size_t length = chunks.size_bytes();
+  size_t bytes_read =
+      file.Read(reinterpret_cast<char*>(chunks.data()), length);
+  end = bytes_read < length;
+  if (end) {
+    // Drop a partial record at the end of the file.
+    size_t partial = bytes_read % sizeof(lczero::V6TrainingData);
+    if (partial > 0 || file.failed()) {
+      std::cerr << "'" << name << "' is truncated or corrupt";
+      if (partial > 0) {
+        std::cerr << ", dropped a partial record of " << partial << " bytes";
+      }
+      std::cerr << std::endl;
+      truncated++;
+    }
+    bytes_read -= partial;
+  }
+  return bytes_read / sizeof(lczero::V6TrainingData);
+}
+
+ChunkFileReader* TrainingDataReader::getCurrentFile() {
+  while (nullptr == file) {
+    auto next = in_files.Next();
+    if (!next) {
       return nullptr;
     }
-    file = gzopen(in_files_it->c_str(), "r");
-    in_files_it++;
+    file_name = std::move(*next);
+    file = OpenFile(file_name);
+  }
+  return file.get();
+}
+
+void TrainingDataReader::PrefetchFiles() {
+  while (true) {
+    std::string name;
+    BoundedQueue<Batch>* batches;
+    {
+      // Stay within prefetch_files of the file being read. Files are listed
+      // under the lock, so that they are taken in order.
+      std::unique_lock<std::mutex> lock(slots_mutex);
+      slot_free.wait(lock, [this] {
+        return stopping || listing_done ||
+               next_file < current_file + slots.size();
+      });
+      if (stopping || listing_done) return;
+      auto next = in_files.Next();
+      if (!next) {
+        listing_done = true;
+        file_taken.notify_all();
+        slot_free.notify_all();
+        return;
+      }
+      name = std::move(*next);
+      size_t index = next_file++;
+      auto& slot = slots[index % slots.size()];
+      slot = std::make_unique<BoundedQueue<Batch>>(kPrefetchBatches);
+      batches = slot.get();
+    }
+    file_taken.notify_all();
+
+    auto reader = OpenFile(name);
+    bool end = nullptr == reader;
+    while (!end) {
+      Batch next(kBatchRecords);
+      next.resize(ReadRecords(*reader, name, next, end));
+      if (next.empty()) continue;
+      // Fails once the reader is being destroyed.
+      if (!batches->Push(std::move(next))) break;
+    }
+    batches->Close();
+  }
+}
+
+size_t TrainingDataReader::ReadPrefetched(
+    std::span<lczero::V6TrainingData> chunks) {
+  size_t records = 0;
+  while (records < chunks.size()) {
+    if (batch_position == batch.size() && !NextBatch()) break;
+    size_t n = std::min(chunks.size() - records, batch.size() - batch_position);
+    std::copy_n(batch.begin() + batch_position, n, chunks.begin() + records);
+    batch_position += n;
+    records += n;
+  }
+  return records;
+}
+
+bool TrainingDataReader::NextBatch() {
+  while (true) {
+    BoundedQueue<Batch>* batches;
+    {
+      std::unique_lock<std::mutex> lock(slots_mutex);
+      file_taken.wait(lock, [this] {
+        return listing_done || next_file > current_file;
+      });
+      if (next_file == current_file) return false;
+      batches = slots[current_file % slots.size()].get();
+    }
+    if (auto next = batches->Pop()) {
+      batch = std::move(*next);
+      batch_position = 0;
+      return true;
+    }
+    // The file is done: its slot can take the next file in the window.
+    {
+      std::lock_guard<std::mutex> lock(slots_mutex);
+      slots[current_file % slots.size()].reset();
+      current_file++;
+    }
+    slot_free.notify_all();
   }
-  return file;
 }
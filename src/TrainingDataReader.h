@@ -1,24 +1,90 @@
 #ifndef TRAININGDATA_TOOL_TRAININGDATAREADER_H
 #define TRAININGDATA_TOOL_TRAININGDATAREADER_H
 
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <span>
+#include <thread>
 #include <vector>
 #include <string>
-#include <zlib.h>
 
+#include "BoundedQueue.h"
+#include "ChunkCodec.h"
+#include "InputFiles.h"
 #include "trainingdata/trainingdata_v6.h"
 
+// Reads the training data files listed by an InputFiles, in its order, as
+// they are listed. Each file is decoded with the codec matching its
+// extension (.gz, .zst or .raw), and the members of packs (.tdpack) are read
+// in turn.
+//
+// A file that ends in a partial record, or whose compressed stream is cut
+// short or corrupt, is reported on std::cerr and counted; the records read
+// before the damage are kept.
+//
+// With read_threads > 0 files are opened and decoded ahead of the caller on
+// that many threads, each thread taking the next file listed, up to
+// prefetch_files files ahead of the one being returned. Records are still
+// returned in exactly the order of a single threaded read.
 class TrainingDataReader {
 public:
-  TrainingDataReader(const std::string &in_directory);
+  // Compressed files are read read_buffer_size bytes at a time.
+  static constexpr size_t kDefaultReadBufferSize = 1 << 20;
+
+  // prefetch_files defaults to twice read_threads, and is never less.
+  TrainingDataReader(InputFiles in_files,
+                     size_t read_buffer_size = kDefaultReadBufferSize,
+                     size_t read_threads = 0, size_t prefetch_files = 0);
   virtual ~TrainingDataReader();
+
+  // Fills chunks with the next records, straight from the decoder, and
+  // returns how many were read. Less than chunks.size() only at the end of
+  // the input.
+  size_t ReadChunks(std::span<lczero::V6TrainingData> chunks);
   std::optional<lczero::V6TrainingData> ReadChunk();
 
+  size_t truncated_files() const { return truncated; }
+
 private:
-  gzFile getCurrentFile();
-  std::vector<std::string> in_files;
-  std::vector<std::string>::iterator in_files_it;
-  gzFile file;
+  using Batch = std::vector<lczero::V6TrainingData>;
+  // Every prefetched file queues up to this many batches of this many
+  // records (about 2 MB) before its thread waits for the caller.
+  static constexpr size_t kBatchRecords = 256;
+  static constexpr size_t kPrefetchBatches = 4;
+
+  std::unique_ptr<ChunkFileReader> OpenFile(const std::string &name) const;
+  // Reads whole records of file into chunks. end is set once the file is
+  // exhausted, after reporting it if it was damaged.
+  size_t ReadRecords(ChunkFileReader &file, const std::string &name,
+                     std::span<lczero::V6TrainingData> chunks, bool &end);
+  ChunkFileReader* getCurrentFile();
+
+  void PrefetchFiles();
+  size_t ReadPrefetched(std::span<lczero::V6TrainingData> chunks);
+  bool NextBatch();
+
+  InputFiles in_files;
+  std::unique_ptr<ChunkFileReader> file;
+  std::string file_name;
+  const size_t read_buffer_size;
+  std::atomic<size_t> truncated = 0;
+
+  // Prefetching: file i queues its batches in slots[i % slots.size()] from
+  // when a thread takes it until the caller has read all of it.
+  std::vector<std::thread> threads;
+  std::vector<std::unique_ptr<BoundedQueue<Batch>>> slots;
+  size_t next_file = 0;     // Next file for a thread to take.
+  size_t current_file = 0;  // File the caller is reading.
+  bool listing_done = false;
+  bool stopping = false;
+  std::mutex slots_mutex;
+  std::condition_variable file_taken;
+  std::condition_variable slot_free;
+  Batch batch;
+  size_t batch_position = 0;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,62 +1,159 @@
 #include "TrainingDataWriter.h"
-#include "trainingdata/writer.h"
+#include "trainingdata.h"
 
+#include <algorithm>
 #include <utility>
 #include <filesystem>
 #include <iomanip>
+#include <iostream>
 #include <sstream>
 
 TrainingDataWriter::TrainingDataWriter(size_t max_files_per_directory,
                                        size_t chunks_per_file,
-                                       std::string dir_prefix)
-    : files_written(0),
+                                       size_t games_per_file,
+                                       std::string dir_prefix,
+                                       FileCounter file_counter,
+                                       CompressionPool* compression_pool)
+    : files_written(file_counter ? std::move(file_counter)
+                                 : std::make_shared<std::atomic<size_t>>(0)),
       max_files_per_directory(max_files_per_directory),
       chunks_per_file(chunks_per_file),
-      dir_prefix(std::move(dir_prefix)){};
+      games_per_file(games_per_file),
+      dir_prefix(std::move(dir_prefix)),
+      compression_pool(compression_pool){};
 
-void TrainingDataWriter::EnqueueChunks(
-    const std::vector<lczero::V6TrainingData> &chunks) {
-  // Write all chunks from this game to a single file (one game per file)
-  std::string directory = dir_prefix + std::to_string(files_written / max_files_per_directory);
-  std::filesystem::create_directories(directory);
+TrainingDataWriter::~TrainingDataWriter() = default;
 
-  std::ostringstream oss;
-  oss << directory << "/game_" << std::setfill('0') << std::setw(6) << files_written << ".gz";
-  std::string filename = oss.str();
+void TrainingDataWriter::EnableShuffle(size_t buffer_records, uint64_t seed) {
+  shuffle_capacity = buffer_records;
+  rng.seed(seed);
+  reservoir.reserve(buffer_records);
+}
 
-  lczero::TrainingDataWriter writer(filename);
+lczero::V6TrainingData& TrainingDataWriter::Append() {
+  if (shuffle_capacity > 0) return ReservoirSlot() = v6_template_record();
+  // The record is built at the end of the shard. The structure is packed,
+  // so any position in the buffer is suitably aligned.
+  WriteChunk(v6_template_record());
+  return *reinterpret_cast<lczero::V6TrainingData*>(
+      shard.data() + shard.size() - sizeof(lczero::V6TrainingData));
+}
+
+void TrainingDataWriter::EndGame() {
+  game_number++;
+  // Games without any chunk do not count towards a shard, and shuffled
+  // shards are only closed when full.
+  if (chunks_in_shard == 0 || shuffle_capacity > 0) return;
+  games_in_shard++;
+  if (chunks_in_shard >= chunks_per_file ||
+      (games_per_file > 0 && games_in_shard >= games_per_file)) {
+    CloseShard();
+  }
+}
+
+void TrainingDataWriter::EnqueueChunks(
+    const std::vector<lczero::V6TrainingData> &chunks) {
   for (const auto& chunk : chunks) {
-    writer.WriteChunk(chunk);
+    AddChunk(chunk);
   }
-  writer.Finalize();
-  files_written++;
+  EndGame();
 }
 
 void TrainingDataWriter::EnqueueChunks(
-    const std::unordered_map<lczero::V6TrainingData, size_t> &chunks) {
-  for (auto chunk : chunks) {
-    chunks_queue.push(chunk.first);
-    WriteQueuedChunks(chunks_per_file);
+    std::span<const lczero::V6TrainingData> chunks) {
+  for (const auto& chunk : chunks) {
+    AddChunk(chunk);
+    if (chunks_in_shard >= chunks_per_file) CloseShard();
   }
 }
 
-void TrainingDataWriter::WriteQueuedChunks(size_t min_chunks) {
-  while (chunks_queue.size() > min_chunks) {
-    std::string directory = dir_prefix + std::to_string(files_written / max_files_per_directory);
-    std::filesystem::create_directories(directory);
+void TrainingDataWriter::AddChunk(const lczero::V6TrainingData& chunk) {
+  if (shuffle_capacity > 0) {
+    ReservoirSlot() = chunk;
+  } else {
+    WriteChunk(chunk);
+  }
+}
 
-    std::ostringstream oss;
-    oss << directory << "/game_" << std::setfill('0') << std::setw(6) << files_written << ".gz";
-    std::string filename = oss.str();
+void TrainingDataWriter::WriteChunk(const lczero::V6TrainingData& chunk) {
+  if (chunks_in_shard == 0) first_game_in_shard = game_number;
+  if (shard.empty()) {
+    shard.reserve(std::min<size_t>(chunks_per_file, 4096) * sizeof(chunk));
+  } else if (shard.size() + sizeof(chunk) > shard.capacity()) {
+    shard_bytes_moved += shard.size();
+  }
+  shard.append(reinterpret_cast<const char*>(&chunk), sizeof(chunk));
+  chunks_in_shard++;
+}
+
+// The slot for a new record: a fresh one until the reservoir is full, then
+// a random one, whose record is written out first. rng() % size is used
+// rather than a std::uniform_int_distribution, whose output differs between
+// standard libraries.
+lczero::V6TrainingData& TrainingDataWriter::ReservoirSlot() {
+  if (reservoir.size() < shuffle_capacity) return reservoir.emplace_back();
+  auto& slot = reservoir[rng() % reservoir.size()];
+  WriteChunk(slot);
+  if (chunks_in_shard >= chunks_per_file) CloseShard();
+  return slot;
+}
+
+void TrainingDataWriter::FlushReservoir() {
+  // Fisher-Yates shuffle of what is left, for the same reason as above.
+  for (size_t i = reservoir.size(); i > 1; --i) {
+    std::swap(reservoir[i - 1], reservoir[rng() % i]);
+  }
+  for (const auto& chunk : reservoir) {
+    WriteChunk(chunk);
+    if (chunks_in_shard >= chunks_per_file) CloseShard();
+  }
+  reservoir.clear();
+}
 
-    lczero::TrainingDataWriter writer(filename);
-    for (size_t i = 0; i < chunks_per_file && !chunks_queue.empty(); ++i) {
-      writer.WriteChunk(chunks_queue.front());
-      chunks_queue.pop();
+void TrainingDataWriter::CloseShard() {
+  if (chunks_in_shard == 0) return;
+  if (compression_pool) {
+    compression_pool->Submit(
+        {compression_pool->packing() ? std::string() : NextFileName(),
+         std::move(shard), input_number, first_game_in_shard,
+         static_cast<uint32_t>(games_in_shard),
+         static_cast<uint32_t>(chunks_in_shard)});
+  } else {
+    std::string file_name = NextFileName();
+    if (!gzip_codec().WriteFile(file_name, shard, -1)) {
+      std::cerr << "Could not write '" << file_name << "'" << std::endl;
     }
-    writer.Finalize();
-    files_written++;
   }
+  shard = std::string();
+  chunks_in_shard = 0;
+  games_in_shard = 0;
 }
 
-void TrainingDataWriter::Finalize() { WriteQueuedChunks(0); }
\ No newline at end of file
+std::string TrainingDataWriter::NextFileName() {
+  // The counter may be shared with writers on other threads, so each file
+  // claims its number atomically.
+  size_t file_id = files_written->fetch_add(1);
+  size_t directory_id = file_id / max_files_per_directory;
+  if (directory_id != current_directory) {
+    std::filesystem::create_directories(dir_prefix +
+                                        std::to_string(directory_id));
+    current_directory = directory_id;
+  }
+  return shard_file_name(
+      dir_prefix, directory_id, file_id,
+      (compression_pool ? compression_pool->codec() : gzip_codec())
+          .extension());
+}
+
+std::string shard_file_name(const std::string& dir_prefix, size_t directory_id,
+                            size_t file_id, const char* extension) {
+  std::ostringstream oss;
+  oss << dir_prefix << directory_id << "/game_" << std::setfill('0')
+      << std::setw(6) << file_id << extension;
+  return oss.str();
+}
+
+void TrainingDataWriter::Finalize() {
+  FlushReservoir();
+  CloseShard();
+}
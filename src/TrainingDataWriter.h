@@ -2,36 +2,104 @@
 #define TRAININGDATA_TOOL_TRAININGDATAWRITER_H
 
 #include <atomic>
-#include <condition_variable>
-#include <mutex>
-#include <queue>
-#include <unordered_map>
+#include <memory>
+#include <random>
+#include <span>
 
 #include "neural/encoder.h"
 #include "neural/network.h"
 #include "trainingdata/trainingdata_v6.h"
 
-#include "V6TrainingDataHashUtil.h"
+#include "ChunkSink.h"
+#include "CompressionPool.h"
 
-class TrainingDataWriter {
+// Shared by writers that must not reuse each other's file numbers.
+using FileCounter = std::shared_ptr<std::atomic<size_t>>;
+
+// Packs training chunks into shard files of up to chunks_per_file chunks
+// and, if games_per_file is not 0, up to games_per_file games. Shards are
+// only closed at the end of a game, so a game never spans two files;
+// games_per_file = 1 writes one file per game. Deduplicated chunks, which
+// have no games, fill every shard to exactly chunks_per_file.
+//
+// As a ChunkSink it builds each record in place at the end of the shard, so
+// a record is copied once, from the template. A finished shard is encoded by the
+// CompressionPool and its codec if there is one, or else gzipped on the
+// calling thread. If the pool writes a pack, shards become pack members
+// instead of files.
+//
+// With a shuffle buffer, records go through a reservoir of a fixed number
+// of records first: once it is full, every new record takes the place of a
+// random one, which is written out. Records leave in an order mixing many
+// games, shards are filled to exactly chunks_per_file like deduplicated
+// ones, and what is left is shuffled and written by Finalize().
+class TrainingDataWriter : public ChunkSink {
  public:
   TrainingDataWriter(size_t max_files_per_directory, size_t chunks_per_file,
-                     std::string dir_prefix = "supervised-");
+                     size_t games_per_file,
+                     std::string dir_prefix = "supervised-",
+                     FileCounter file_counter = nullptr,
+                     CompressionPool* compression_pool = nullptr);
+  ~TrainingDataWriter() override;
+
+  lczero::V6TrainingData& Append() override;
+  void EndGame() override;
 
+  // Writes the chunks of one game.
   void EnqueueChunks(const std::vector<lczero::V6TrainingData>& chunks);
-  void EnqueueChunks(
-      const std::unordered_map<lczero::V6TrainingData, size_t>& chunks);
+  // Writes chunks that belong to no game, such as deduplicated ones.
+  void EnqueueChunks(std::span<const lczero::V6TrainingData> chunks);
 
+  // Closes the current shard.
   void Finalize();
 
+  // Number of the next game in its PGN file, counting every game of the
+  // file from 0, and index of that file among the inputs, which the pack
+  // index records. Games not numbered by SetGame() follow the previous one.
+  void SetGame(uint64_t game) { game_number = game; }
+  void SetInput(uint32_t input) { input_number = input; }
+
+  // Shuffles records through a reservoir of buffer_records records. The
+  // output only depends on the input and seed.
+  void EnableShuffle(size_t buffer_records, uint64_t seed);
+
+  // Bytes of records moved so far when a shard outgrew its buffer.
+  size_t bytes_moved() const { return shard_bytes_moved; }
+
  private:
-  void WriteQueuedChunks(size_t min_chunks);
+  void AddChunk(const lczero::V6TrainingData& chunk);
+  void WriteChunk(const lczero::V6TrainingData& chunk);
+  lczero::V6TrainingData& ReservoirSlot();
+  void FlushReservoir();
+  void CloseShard();
+  std::string NextFileName();
+
+  // Uncompressed records of the shard being written.
+  std::string shard;
+  size_t chunks_in_shard = 0;
+  size_t games_in_shard = 0;
+  uint64_t first_game_in_shard = 0;
+  size_t shard_bytes_moved = 0;
+  // Game being appended, and its input file.
+  uint64_t game_number = 0;
+  uint32_t input_number = 0;
+  // Shuffle reservoir, used if shuffle_capacity is not 0.
+  std::vector<lczero::V6TrainingData> reservoir;
+  size_t shuffle_capacity = 0;
+  std::mt19937_64 rng;
 
-  std::queue<lczero::V6TrainingData> chunks_queue;
-  size_t files_written;
+  FileCounter files_written;
   size_t max_files_per_directory;
   size_t chunks_per_file;
+  size_t games_per_file;
   const std::string dir_prefix;
+  CompressionPool* compression_pool;
+  // Output directory last created, to skip create_directories per file.
+  size_t current_directory = SIZE_MAX;
 };
 
-#endif
\ No newline at end of file
+// Name of output file number file_id, in directory dir_prefix<directory_id>.
+std::string shard_file_name(const std::string& dir_prefix, size_t directory_id,
+                            size_t file_id, const char* extension);
+
+#endif
@@ -1,11 +1,55 @@
 #ifndef TRAININGDATA_TOOL_V6TRAININGDATAHASHUTIL_H
 #define TRAININGDATA_TOOL_V6TRAININGDATAHASHUTIL_H
 
+#include <cstdint>
+
 #include "utils/hashcat.h"
 #include "trainingdata/trainingdata_v6.h"
 
 #define ARR_LENGTH(a) (sizeof(a) / sizeof(a[0]))
 
+// 128 bits identifying the position of a record: its planes, castling
+// rights, side to move and rule50 count, the fields std::equal_to compares
+// below. Records of different positions get the same fingerprint with a
+// probability of about 2^-128 per pair, so tables keyed on it only compare
+// whole records when fingerprints are equal.
+struct PositionFingerprint {
+  uint64_t high;
+  uint64_t low;
+
+  bool operator==(const PositionFingerprint&) const = default;
+};
+
+namespace detail {
+// splitmix64's finalizer: every input bit affects every output bit.
+inline uint64_t mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+}  // namespace detail
+
+inline PositionFingerprint position_fingerprint(
+    const lczero::V6TrainingData& k) {
+  // Two lanes with different seeds and input scrambling, so that their
+  // collisions are independent.
+  uint64_t high = 0x243f6a8885a308d3ULL;
+  uint64_t low = 0x13198a2e03707344ULL;
+  auto add = [&](uint64_t word) {
+    high = detail::mix64(high + word);
+    low = detail::mix64(low ^ (word * 0x9e3779b97f4a7c15ULL));
+  };
+  for (size_t i = 0; i < ARR_LENGTH(k.planes); ++i) add(k.planes[i]);
+  add(uint64_t{k.castling_us_ooo} | uint64_t{k.castling_us_oo} << 8 |
+      uint64_t{k.castling_them_ooo} << 16 |
+      uint64_t{k.castling_them_oo} << 24 |
+      uint64_t{k.side_to_move_or_enpassant} << 32 |
+      uint64_t{k.rule50_count} << 40);
+  return {high, low};
+}
+
 namespace std {
 template <>
 struct hash<lczero::V6TrainingData> {
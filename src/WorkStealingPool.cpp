@@ -0,0 +1,56 @@
+#include "WorkStealingPool.h"
+
+#include <thread>
+
+WorkStealingPool::WorkStealingPool(size_t num_threads)
+    : num_threads(num_threads ? num_threads : 1) {
+  for (size_t i = 0; i < this->num_threads; ++i) {
+    deques.push_back(std::make_unique<TaskDeque>());
+  }
+}
+
+void WorkStealingPool::Run(std::vector<Task> tasks) {
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    deques[i % num_threads]->tasks.push_back(std::move(tasks[i]));
+  }
+
+  // No task spawns new ones, so a thread that finds every deque empty is
+  // done for good.
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < num_threads; ++i) {
+    threads.emplace_back([this, i] { WorkerLoop(i); });
+  }
+  for (auto& thread : threads) thread.join();
+}
+
+void WorkStealingPool::WorkerLoop(size_t thread_idx) {
+  while (true) {
+    auto task = PopOwn(thread_idx);
+    if (!task) task = Steal(thread_idx);
+    if (!task) return;
+    (*task)();
+  }
+}
+
+std::optional<WorkStealingPool::Task> WorkStealingPool::PopOwn(
+    size_t thread_idx) {
+  TaskDeque& own = *deques[thread_idx];
+  std::lock_guard<std::mutex> lock(own.mutex);
+  if (own.tasks.empty()) return std::nullopt;
+  Task task = std::move(own.tasks.front());
+  own.tasks.pop_front();
+  return task;
+}
+
+std::optional<WorkStealingPool::Task> WorkStealingPool::Steal(
+    size_t thread_idx) {
+  for (size_t offset = 1; offset < num_threads; ++offset) {
+    TaskDeque& victim = *deques[(thread_idx + offset) % num_threads];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (victim.tasks.empty()) continue;
+    Task task = std::move(victim.tasks.back());
+    victim.tasks.pop_back();
+    return task;
+  }
+  return std::nullopt;
+}
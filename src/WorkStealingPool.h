@@ -0,0 +1,41 @@
+#ifndef TRAININGDATA_TOOL_WORKSTEALINGPOOL_H
+#define TRAININGDATA_TOOL_WORKSTEALINGPOOL_H
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+// Runs a fixed batch of independent tasks on a pool of threads.
+//
+// Tasks are dealt round-robin to per-thread deques in submission order. Each
+// thread works through its own deque from the front and, once it runs dry,
+// steals from the back of the other threads' deques. Submitting the most
+// expensive tasks first therefore starts them first, while the cheap tail is
+// balanced by stealing.
+class WorkStealingPool {
+ public:
+  using Task = std::function<void()>;
+
+  explicit WorkStealingPool(size_t num_threads);
+
+  // Blocks until every task has finished.
+  void Run(std::vector<Task> tasks);
+
+ private:
+  struct TaskDeque {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void WorkerLoop(size_t thread_idx);
+  std::optional<Task> PopOwn(size_t thread_idx);
+  std::optional<Task> Steal(size_t thread_idx);
+
+  const size_t num_threads;
+  std::vector<std::unique_ptr<TaskDeque>> deques;
+};
+
+#endif
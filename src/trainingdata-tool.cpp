@@ -2,21 +2,56 @@
 #include "pgn.h"
 #include "polyglot_lib.h"
 
+#include <algorithm>
 #include <cstring>
 #include <filesystem>
 #include <iostream>
 
+#include "AsyncFileWriter.h"
+#include "Benchmarks.h"
+#include "ChunkPack.h"
+#include "CompressionPool.h"
+#include "ConversionPipeline.h"
+#include "DataSplit.h"
+#include "GameFilter.h"
+#include "GameSource.h"
+#include "InputFiles.h"
 #include "PGNGame.h"
+#include "PGNIndex.h"
 #include "TrainingDataDedup.h"
 #include "TrainingDataReader.h"
 #include "TrainingDataWriter.h"
+#include "WorkStealingPool.h"
 
 size_t max_files_per_directory = 10000;
 int64_t max_games_to_convert = 10000000;
 size_t chunks_per_file = 4096;
+size_t games_per_file = 0;
+size_t num_threads = 1;
+size_t parallel_files = 1;
+int64_t start_game = 0;
+int64_t split_games = 0;
+bool fast_lexer = false;
+GameFilter game_filter;
 size_t dedup_uniq_buffersize = 50000;
+size_t read_buffer_size = TrainingDataReader::kDefaultReadBufferSize;
+size_t read_threads = 0;
+size_t prefetch_files = 0;  // 0: twice read_threads
+std::string input_glob = InputFiles::kWriterGlob;
+const std::string dedup_prefix = "deduped-";
 float dedup_q_ratio = 1.0f;
 std::string output_prefix = "supervised-";
+const ChunkCodec *output_codec = &gzip_codec();
+int compression_level = -1;  // The codec's default
+size_t compression_threads = 0;  // 0: one per converting thread
+CompressionPool *compression_pool = nullptr;
+std::string pack_file_name;
+IoBackend io_backend = IoBackend::kAuto;
+size_t io_depth = 8;
+bool fsync_output = false;
+std::vector<DataSplit> data_splits;
+size_t shuffle_buffer_mb = 0;
+uint64_t shuffle_seed = 0;
 
 inline bool file_exists(const std::string &name) {
   auto s = std::filesystem::status(name);
@@ -28,23 +63,144 @@ inline bool directory_exists(const std::string &name) {
   return std::filesystem::is_directory(s);
 }
 
-void convert_games(const std::string &pgn_file_name, Options options,
-                   const std::string &prefix) {
-  int game_id = 0;
-  pgn_t pgn[1];
-  pgn_open(pgn, pgn_file_name.c_str());
-  TrainingDataWriter writer(max_files_per_directory, chunks_per_file, prefix);
-  while (pgn_next_game(pgn) && game_id < max_games_to_convert) {
-    PGNGame game(pgn);
-    writer.EnqueueChunks(game.getChunks(options));
-    game_id++;
-    if (game_id % 1000 == 0) {
-      std::cout << game_id << " games written." << std::endl;
+// A piece of a PGN file to convert: up to max_games games starting at byte
+// offset, which is either 0 or the start of a game taken from the file's
+// PGNIndex.
+struct Work {
+  uint64_t bytes;
+  std::string name;
+  // Index of the file among the inputs, for the pack index.
+  uint32_t input;
+  uint64_t offset;
+  // Number of the game at offset in the file, for the pack index.
+  int64_t first_game;
+  int64_t max_games;
+  // If not negative, ends the input after that many games of the file,
+  // filtered ones included, so that the piece stops where the next one
+  // starts. -1 for whole files.
+  int64_t range_games;
+};
+
+// file_counters has one counter per split, or a single one without splits.
+// With shuffle_records > 0, every split writer shuffles through a reservoir
+// of that many records, seeded from the shuffle seed, unit (the number of
+// this piece of work) and the split.
+void convert_games(const Work &work, Options options,
+                   const std::string &prefix,
+                   const std::vector<FileCounter> &file_counters,
+                   size_t shuffle_records, size_t unit) {
+  int64_t game_id = 0;
+  auto source = open_game_source(work.name, work.offset, fast_lexer,
+                                 options.keepComments(), game_filter);
+  if (work.range_games >= 0) source->LimitGames(work.range_games);
+  std::vector<std::unique_ptr<TrainingDataWriter>> split_writers;
+  for (size_t i = 0; i < file_counters.size(); ++i) {
+    auto writer = std::make_unique<TrainingDataWriter>(
+        max_files_per_directory, chunks_per_file, games_per_file,
+        data_splits.empty() ? prefix : prefix + data_splits[i].name + "-",
+        file_counters[i], compression_pool);
+    writer->SetInput(work.input);
+    if (shuffle_records > 0) {
+      writer->EnableShuffle(shuffle_records,
+                            shuffle_seed + unit * file_counters.size() + i);
+    }
+    split_writers.push_back(std::move(writer));
+  }
+  SplitWriters writers(data_splits, std::move(split_writers));
+  if (num_threads > 1) {
+    ConversionPipeline pipeline(options, num_threads, writers);
+    game_id = pipeline.Run(*source, work.max_games, work.first_game);
+  } else {
+    while (game_id < work.max_games) {
+      auto game = source->NextGame();
+      if (!game) break;
+      auto &writer = writers.WriterForGame(writers.Route(*game));
+      writer.SetGame(work.first_game + source->last_game());
+      game->getChunks(options, writer);
+      writer.EndGame();
+      game_id++;
+      if (game_id % 1000 == 0) {
+        std::cout << game_id << " games written." << std::endl;
+      }
     }
   }
-  writer.Finalize();
-  std::cout << "Finished writing " << game_id << " games." << std::endl;
-  pgn_close(pgn);
+  writers.Finalize();
+  std::cout << "Finished writing " << game_id << " games from '"
+            << work.name << "'." << std::endl;
+  writers.Report(std::cout);
+  if (source->games_filtered() > 0) {
+    std::cout << "Skipped " << source->games_filtered()
+              << " games rejected by the filters." << std::endl;
+  }
+}
+
+void convert_files(std::vector<std::string> pgn_file_names, Options options) {
+  // One numbering space per split for every file, so outputs never collide.
+  std::vector<FileCounter> file_counters;
+  for (size_t i = 0; i < std::max<size_t>(data_splits.size(), 1); ++i) {
+    file_counters.push_back(std::make_shared<std::atomic<size_t>>(0));
+  }
+
+  std::vector<Work> work;
+  for (uint32_t input = 0; input < pgn_file_names.size(); ++input) {
+    const std::string &name = pgn_file_names[input];
+    if (is_streaming_input(name)) {
+      if (start_game != 0 || split_games != 0) {
+        std::cout << "'" << name << "' is read as a stream, converting it "
+                  << "from the start as a single piece." << std::endl;
+      }
+      uint64_t bytes = name == "-" ? 0 : std::filesystem::file_size(name);
+      work.push_back({bytes, name, input, 0, 0, max_games_to_convert, -1});
+      continue;
+    }
+    if (start_game == 0 && split_games == 0) {
+      work.push_back({std::filesystem::file_size(name), name, input, 0, 0,
+                      max_games_to_convert, -1});
+      continue;
+    }
+    // Seeking to a game or splitting a file needs the game offsets.
+    PGNIndex index = PGNIndex::LoadOrBuild(name);
+    int64_t end = std::min(static_cast<int64_t>(index.size()),
+                           start_game + max_games_to_convert);
+    int64_t step = split_games > 0 ? split_games : end - start_game;
+    for (int64_t begin = start_game; begin < end; begin += step) {
+      GameRange range{begin, std::min(end, begin + step)};
+      int64_t games = range.end - range.begin;
+      work.push_back({index.RangeBytes(range), name, input,
+                      index.offset(begin), begin, games, games});
+    }
+  }
+
+  // Biggest pieces first: they bound the total run time.
+  std::stable_sort(work.begin(), work.end(),
+                   [](const Work &a, const Work &b) { return a.bytes > b.bytes; });
+
+  // The shuffle buffer is shared by the writers converting at the same time:
+  // one per split for each piece converted in parallel.
+  size_t shuffle_records = 0;
+  if (shuffle_buffer_mb > 0 && !work.empty()) {
+    size_t live_writers =
+        std::min(std::max<size_t>(parallel_files, 1), work.size()) *
+        file_counters.size();
+    shuffle_records = std::max<size_t>(
+        (shuffle_buffer_mb << 20) / sizeof(lczero::V6TrainingData) /
+            live_writers,
+        1);
+  }
+
+  std::vector<WorkStealingPool::Task> tasks;
+  for (size_t unit = 0; unit < work.size(); ++unit) {
+    const Work &w = work[unit];
+    tasks.push_back([w, options, file_counters, shuffle_records, unit] {
+      if (options.verbose) {
+        std::cout << "Opening '" << w.name << "' at byte " << w.offset
+                  << std::endl;
+      }
+      convert_games(w, options, output_prefix, file_counters, shuffle_records,
+                    unit);
+    });
+  }
+  WorkStealingPool(parallel_files).Run(std::move(tasks));
 }
 
 int main(int argc, char *argv[]) {
@@ -52,6 +208,13 @@ int main(int argc, char *argv[]) {
   polyglot_init();
   Options options;
   bool deduplication_mode = false;
+  bool build_index_only = false;
+  bool benchmark_lexer = false;
+  bool benchmark_policy = false;
+  bool benchmark_encoder = false;
+  bool benchmark_sink = false;
+  bool benchmark_codecs = false;
+  std::string extract_pack_name;
   for (size_t idx = 0; idx < argc; ++idx) {
     if (0 == static_cast<std::string>("-v").compare(argv[idx])) {
       std::cout << "Verbose mode ON" << std::endl;
@@ -60,6 +223,7 @@ int main(int argc, char *argv[]) {
                static_cast<std::string>("-lichess-mode").compare(argv[idx])) {
       std::cout << "Lichess mode ON" << std::endl;
       options.lichess_mode = true;
+      game_filter.require_eval = true;
     } else if (0 ==
                static_cast<std::string>("-files-per-dir").compare(argv[idx])) {
       max_files_per_directory = std::atoi(argv[idx + 1]);
@@ -74,6 +238,14 @@ int main(int argc, char *argv[]) {
                         .compare(argv[idx])) {
       chunks_per_file = std::atoi(argv[idx + 1]);
       std::cout << "Chunks per file set to: " << chunks_per_file << std::endl;
+    } else if (0 == static_cast<std::string>("-games-per-file")
+                        .compare(argv[idx])) {
+      games_per_file = std::atoi(argv[idx + 1]);
+      std::cout << "Games per file set to: " << games_per_file << std::endl;
+    } else if (0 == static_cast<std::string>("-one-game-per-file")
+                        .compare(argv[idx])) {
+      games_per_file = 1;
+      std::cout << "One game per file mode ON" << std::endl;
     } else if (0 == static_cast<std::string>("-deduplication-mode")
                         .compare(argv[idx])) {
       deduplication_mode = true;
@@ -88,25 +260,279 @@ int main(int argc, char *argv[]) {
       dedup_q_ratio = std::stof(argv[idx + 1]);
       std::cout << "Deduplication Q ratio set to: " << dedup_q_ratio
                 << std::endl;
+    } else if (0 == static_cast<std::string>("-read-buffer-kb")
+                        .compare(argv[idx])) {
+      read_buffer_size = std::atoi(argv[idx + 1]) * size_t{1024};
+      std::cout << "Read buffer size set to: " << read_buffer_size / 1024
+                << " KB" << std::endl;
+    } else if (0 ==
+               static_cast<std::string>("-input-glob").compare(argv[idx])) {
+      input_glob = argv[idx + 1];
+      std::cout << "Input glob set to: " << input_glob << std::endl;
+    } else if (0 ==
+               static_cast<std::string>("-read-threads").compare(argv[idx])) {
+      read_threads = std::atoi(argv[idx + 1]);
+      std::cout << "Read threads set to: " << read_threads << std::endl;
+    } else if (0 == static_cast<std::string>("-prefetch-files")
+                        .compare(argv[idx])) {
+      prefetch_files = std::atoi(argv[idx + 1]);
+      std::cout << "Prefetched files set to: " << prefetch_files << std::endl;
+    } else if (0 == static_cast<std::string>("-threads").compare(argv[idx])) {
+      num_threads = std::atoi(argv[idx + 1]);
+      std::cout << "Conversion threads set to: " << num_threads << std::endl;
+    } else if (0 ==
+               static_cast<std::string>("-parallel-files").compare(argv[idx])) {
+      parallel_files = std::atoi(argv[idx + 1]);
+      std::cout << "Files converted in parallel set to: " << parallel_files
+                << std::endl;
+    } else if (0 ==
+               static_cast<std::string>("-start-game").compare(argv[idx])) {
+      start_game = std::atoll(argv[idx + 1]);
+      std::cout << "Start game set to: " << start_game << std::endl;
+    } else if (0 ==
+               static_cast<std::string>("-split-games").compare(argv[idx])) {
+      split_games = std::atoll(argv[idx + 1]);
+      std::cout << "Games per work unit set to: " << split_games << std::endl;
+    } else if (0 ==
+               static_cast<std::string>("-build-index").compare(argv[idx])) {
+      build_index_only = true;
+      std::cout << "Index building mode ON" << std::endl;
+    } else if (0 ==
+               static_cast<std::string>("-fast-lexer").compare(argv[idx])) {
+      fast_lexer = true;
+      std::cout << "Fast PGN lexer ON" << std::endl;
+    } else if (0 ==
+               static_cast<std::string>("-input-format").compare(argv[idx])) {
+      pblczero::NetworkFormat::InputFormat input_format;
+      if (!parse_input_format(argv[idx + 1], input_format)) {
+        std::cerr << "Unsupported input format: " << argv[idx + 1]
+                  << std::endl;
+        return 1;
+      }
+      options.fill_training_data = training_data_filler(input_format);
+      std::cout << "Input format set to: " << argv[idx + 1] << std::endl;
+    } else if (0 == static_cast<std::string>("-min-elo").compare(argv[idx])) {
+      game_filter.min_elo = std::atoi(argv[idx + 1]);
+      std::cout << "Minimum Elo set to: " << game_filter.min_elo << std::endl;
+    } else if (0 ==
+               static_cast<std::string>("-time-control").compare(argv[idx])) {
+      game_filter.time_controls = argv[idx + 1];
+      std::cout << "Time controls set to: " << game_filter.time_controls
+                << std::endl;
+    } else if (0 ==
+               static_cast<std::string>("-standard-only").compare(argv[idx])) {
+      game_filter.standard_only = true;
+      std::cout << "Standard variant only ON" << std::endl;
+    } else if (0 == static_cast<std::string>("-benchmark-lexer")
+                        .compare(argv[idx])) {
+      benchmark_lexer = true;
+      std::cout << "PGN reader benchmark mode ON" << std::endl;
+    } else if (0 == static_cast<std::string>("-benchmark-policy")
+                        .compare(argv[idx])) {
+      benchmark_policy = true;
+      std::cout << "Policy index benchmark mode ON" << std::endl;
+    } else if (0 == static_cast<std::string>("-benchmark-encoder")
+                        .compare(argv[idx])) {
+      benchmark_encoder = true;
+      std::cout << "History encoder benchmark mode ON" << std::endl;
+    } else if (0 ==
+               static_cast<std::string>("-benchmark-sink").compare(argv[idx])) {
+      benchmark_sink = true;
+      std::cout << "Chunk sink benchmark mode ON" << std::endl;
+    } else if (0 == static_cast<std::string>("-benchmark-codecs")
+                        .compare(argv[idx])) {
+      benchmark_codecs = true;
+      std::cout << "Output codec benchmark mode ON" << std::endl;
+    } else if (0 ==
+               static_cast<std::string>("-output-codec").compare(argv[idx])) {
+      output_codec = codec_by_name(argv[idx + 1]);
+      if (nullptr == output_codec) {
+        std::cerr << "Unsupported output codec: " << argv[idx + 1]
+                  << std::endl;
+        return 1;
+      }
+      std::cout << "Output codec set to: " << output_codec->name()
+                << std::endl;
+    } else if (0 == static_cast<std::string>("-shuffle-buffer-mb")
+                        .compare(argv[idx])) {
+      int64_t megabytes = std::atoll(argv[idx + 1]);
+      if (megabytes < 0) {
+        std::cerr << "Invalid shuffle buffer size: " << argv[idx + 1]
+                  << std::endl;
+        return 1;
+      }
+      shuffle_buffer_mb = megabytes;
+      std::cout << "Shuffle buffer size set to: " << shuffle_buffer_mb
+                << " MB" << std::endl;
+    } else if (0 ==
+               static_cast<std::string>("-shuffle-seed").compare(argv[idx])) {
+      shuffle_seed = std::strtoull(argv[idx + 1], nullptr, 10);
+      std::cout << "Shuffle seed set to: " << shuffle_seed << std::endl;
+    } else if (0 ==
+               static_cast<std::string>("-io-backend").compare(argv[idx])) {
+      if (!parse_io_backend(argv[idx + 1], io_backend)) {
+        std::cerr << "Unsupported I/O backend: " << argv[idx + 1]
+                  << std::endl;
+        return 1;
+      }
+      std::cout << "I/O backend set to: " << argv[idx + 1] << std::endl;
+    } else if (0 == static_cast<std::string>("-io-depth").compare(argv[idx])) {
+      io_depth = std::atoi(argv[idx + 1]);
+      std::cout << "Files in flight set to: " << io_depth << std::endl;
+    } else if (0 == static_cast<std::string>("-fsync").compare(argv[idx])) {
+      fsync_output = true;
+      std::cout << "fsync mode ON" << std::endl;
+    } else if (0 == static_cast<std::string>("-split").compare(argv[idx])) {
+      if (!parse_data_splits(argv[idx + 1], data_splits)) {
+        std::cerr << "Invalid splits: " << argv[idx + 1] << std::endl;
+        return 1;
+      }
+      std::cout << "Splits set to: " << argv[idx + 1] << std::endl;
+    } else if (0 == static_cast<std::string>("-pack").compare(argv[idx])) {
+      pack_file_name = argv[idx + 1];
+      std::cout << "Output pack set to: " << pack_file_name << std::endl;
+    } else if (0 ==
+               static_cast<std::string>("-extract-pack").compare(argv[idx])) {
+      extract_pack_name = argv[idx + 1];
+      std::cout << "Pack to extract set to: " << extract_pack_name
+                << std::endl;
+    } else if (0 == static_cast<std::string>("-compression-level")
+                        .compare(argv[idx])) {
+      compression_level = std::atoi(argv[idx + 1]);
+      std::cout << "Compression level set to: " << compression_level
+                << std::endl;
+    } else if (0 == static_cast<std::string>("-compression-threads")
+                        .compare(argv[idx])) {
+      compression_threads = std::atoi(argv[idx + 1]);
+      std::cout << "Compression threads set to: " << compression_threads
+                << std::endl;
     } else if (0 == static_cast<std::string>("-output").compare(argv[idx])) {
       output_prefix = argv[idx + 1];
       std::cout << "Output prefix set to: " << output_prefix << std::endl;
     }
   }
 
-  TrainingDataWriter writer(max_files_per_directory, chunks_per_file,
-                            "deduped-");
+  if (!output_codec->ValidLevel(compression_level)) {
+    std::cerr << "Unsupported " << output_codec->name()
+              << " compression level: " << compression_level << std::endl;
+    return 1;
+  }
+
+  if (!data_splits.empty() && !pack_file_name.empty()) {
+    std::cerr << "-split cannot be combined with -pack." << std::endl;
+    return 1;
+  }
+
+  // Packs are only recognised by their extension when read back.
+  if (!pack_file_name.empty() && !is_pack_file(pack_file_name)) {
+    std::cerr << "The -pack file name must end in " << kPackExtension << "."
+              << std::endl;
+    return 1;
+  }
+
+  if (!extract_pack_name.empty()) {
+    size_t files;
+    bool ok = extract_pack(extract_pack_name, output_prefix,
+                           max_files_per_directory, files);
+    std::cout << "Extracted " << files << " files from '"
+              << extract_pack_name << "'." << std::endl;
+    return ok ? 0 : 1;
+  }
+
+  // Declared before the pool, which hands its last shards to them when
+  // destroyed.
+  auto file_writer = make_async_file_writer(io_backend, io_depth, fsync_output);
+  std::unique_ptr<ChunkPackWriter> pack;
+  if (!pack_file_name.empty()) {
+    pack = std::make_unique<ChunkPackWriter>(pack_file_name, *output_codec);
+    if (!pack->ok()) return 1;
+  }
+
+  if (0 == compression_threads) {
+    compression_threads = std::max(num_threads, parallel_files);
+  }
+  CompressionPool pool(compression_threads, *output_codec, compression_level,
+                       pack.get(), file_writer.get());
+  compression_pool = &pool;
+
+  TrainingDataWriter writer(max_files_per_directory, chunks_per_file, 0,
+                            dedup_prefix, nullptr, compression_pool);
+  if (shuffle_buffer_mb > 0) {
+    // The only writer of the run gets the whole buffer.
+    writer.EnableShuffle(std::max<size_t>(
+                             (shuffle_buffer_mb << 20) /
+                                 sizeof(lczero::V6TrainingData),
+                             1),
+                         shuffle_seed);
+  }
+  std::vector<std::string> pgn_file_names;
+  std::vector<std::string> input_roots;
   for (size_t idx = 1; idx < argc; ++idx) {
+    // The pack being written is neither a PGN nor training data to read.
+    if (pack_file_name == argv[idx]) continue;
     if (deduplication_mode) {
-      if (!directory_exists(argv[idx])) continue;
-      TrainingDataReader reader(argv[idx]);
-      training_data_dedup(reader, writer, dedup_uniq_buffersize, dedup_q_ratio);
+      if (!directory_exists(argv[idx]) &&
+          !(file_exists(argv[idx]) && (is_pack_file(argv[idx]) ||
+                                       codec_for_file(argv[idx])))) {
+        continue;
+      }
+      input_roots.push_back(argv[idx]);
     } else {
-      if (!file_exists(argv[idx])) continue;
-      if (options.verbose) {
-        std::cout << "Opening '" << argv[idx] << "'" << std::endl;
+      if (0 != strcmp(argv[idx], "-") && !file_exists(argv[idx])) continue;
+      pgn_file_names.push_back(argv[idx]);
+    }
+  }
+  if (!input_roots.empty()) {
+    // Never read the files this run writes: its pack and its deduped-N
+    // directories.
+    std::vector<std::string> outputs;
+    if (!pack_file_name.empty()) outputs.push_back(pack_file_name);
+    TrainingDataReader reader(
+        InputFiles(input_roots, input_glob, outputs, {dedup_prefix}),
+        read_buffer_size, read_threads, prefetch_files);
+    training_data_dedup(reader, writer, dedup_uniq_buffersize, dedup_q_ratio);
+  }
+  if (build_index_only) {
+    for (const auto &name : pgn_file_names) {
+      if (!is_streaming_input(name)) PGNIndex::LoadOrBuild(name);
+    }
+  } else if (benchmark_lexer) {
+    for (const auto &name : pgn_file_names) {
+      if (!is_streaming_input(name)) benchmark_pgn_readers(name);
+    }
+  } else if (benchmark_policy) {
+    for (const auto &name : pgn_file_names) {
+      if (!is_streaming_input(name) && !benchmark_policy_index(name)) {
+        return 1;
+      }
+    }
+  } else if (benchmark_encoder) {
+    for (const auto &name : pgn_file_names) {
+      if (!is_streaming_input(name)) benchmark_history_encoder(name);
+    }
+  } else if (benchmark_sink) {
+    for (const auto &name : pgn_file_names) {
+      if (!is_streaming_input(name)) benchmark_chunk_sinks(name, options);
+    }
+  } else if (benchmark_codecs) {
+    for (const auto &name : pgn_file_names) {
+      if (!is_streaming_input(name)) {
+        benchmark_output_codecs(name, options, compression_level);
       }
-      convert_games(argv[idx], options, output_prefix);
     }
+  } else if (!pgn_file_names.empty()) {
+    convert_files(std::move(pgn_file_names), options);
+  }
+
+  pool.Finish();
+  file_writer->Finish();
+  file_writer->Report(std::cout);
+  // A full disk must not look like a successful run.
+  size_t failures = pool.failed_shards() + file_writer->failed_files();
+  if (pack && !pack->Finish()) failures++;
+  if (failures > 0) {
+    std::cerr << failures << " output files could not be written."
+              << std::endl;
+    return 1;
   }
 }
@@ -1,7 +1,9 @@
 #include "trainingdata.h"
+#include "PolicyIndex.h"
 #include "utils/bititer.h"
 
 #include <algorithm>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 
@@ -12,34 +14,80 @@ namespace lczero {
 // Minimal implementation if not linked (it should be linked from lc0 utils, but
 // to be safe) Actually lc0 has it in utils/bitmanip.h -> utils/bititer.h
 
-lczero::V6TrainingData get_v6_training_data(
-    lczero::GameResult game_result, const lczero::PositionHistory& history,
-    lczero::Move played_move, lczero::MoveList legal_moves, float Q,
-    lczero::Move best_move, uint32_t visits) {
+namespace {
+
+lczero::V6TrainingData make_template_record() {
   lczero::V6TrainingData result;
   std::memset(&result, 0, sizeof(result));
-
   result.version = 6;
   // Use Classical 112 plane format
-  auto input_format = pblczero::NetworkFormat::INPUT_CLASSICAL_112_PLANE;
-  result.input_format = input_format;
+  result.input_format = pblczero::NetworkFormat::INPUT_CLASSICAL_112_PLANE;
+  // Every move illegal until the position says otherwise
+  std::fill(std::begin(result.probabilities), std::end(result.probabilities),
+            -1.0f);
+  return result;
+}
 
-  // Initialize probabilities to -1 (illegal)
-  for (auto& probability : result.probabilities) {
-    probability = -1.0f;
-  }
+}  // namespace
+
+const lczero::V6TrainingData& v6_template_record() {
+  static const lczero::V6TrainingData record = make_template_record();
+  return record;
+}
+
+namespace {
+
+using InputFormat = pblczero::NetworkFormat::InputFormat;
+
+// Properties of an input format that change what goes into the record, as
+// lczero::IsCanonicalFormat and lczero::Is960CastlingFormat.
+constexpr bool is_canonical(InputFormat format) {
+  return format == pblczero::NetworkFormat::INPUT_112_WITH_CANONICALIZATION ||
+         format == pblczero::NetworkFormat::
+                       INPUT_112_WITH_CANONICALIZATION_HECTOPLIES ||
+         format == pblczero::NetworkFormat::
+                       INPUT_112_WITH_CANONICALIZATION_HECTOPLIES_ARMAGEDDON ||
+         format ==
+             pblczero::NetworkFormat::INPUT_112_WITH_CANONICALIZATION_V2 ||
+         format == pblczero::NetworkFormat::
+                       INPUT_112_WITH_CANONICALIZATION_V2_ARMAGEDDON;
+}
 
-  // Legal moves to 0
-  for (lczero::Move move : legal_moves) {
-    uint16_t idx = lczero::MoveToNNIndex(move, 0);
-    if (idx < 1858) {
-      result.probabilities[idx] = 0.0f;
+constexpr bool has_960_castling(InputFormat format) {
+  return format != pblczero::NetworkFormat::INPUT_CLASSICAL_112_PLANE;
+}
+
+template <InputFormat kFormat>
+void fill_v6_training_data_for(
+    lczero::V6TrainingData& result, lczero::GameResult game_result,
+    const lczero::PositionHistory& history, lczero::Move played_move,
+    const lczero::MoveList& legal_moves, float Q, lczero::Move best_move,
+    uint32_t visits, HistoryEncoder* history_encoder) {
+  result.input_format = kFormat;
+
+  // Populate planes. V6 stores the first 104 planes (8 history * 13 planes).
+  // Canonical formats pick a transform per position, which moves and the
+  // en passant mask below have to follow.
+  int transform = 0;
+  if (kFormat == pblczero::NetworkFormat::INPUT_CLASSICAL_112_PLANE &&
+      history_encoder) {
+    history_encoder->Encode(history, result.planes);
+  } else {
+    lczero::InputPlanes planes =
+        lczero::EncodePositionForNN(kFormat, history, 8,
+                                    lczero::FillEmptyHistory::FEN_ONLY,
+                                    &transform);
+    for (size_t i = 0; i < 104 && i < planes.size(); ++i) {
+      result.planes[i] = lczero::ReverseBitsInBytes(planes[i].mask);
     }
   }
 
+  // Legal moves to 0, the template has -1 everywhere else
+  set_policy_legal_moves(legal_moves, result.probabilities, transform);
+
   // Played move to 1 (with bounds check to prevent crash from invalid moves)
-  uint16_t played_idx = lczero::MoveToNNIndex(played_move, 0);
-  if (played_idx < 1858) {
+  uint16_t played_idx = policy_index(played_move, transform);
+  if (played_idx < kPolicySize) {
     result.probabilities[played_idx] = 1.0f;
   } else {
 // Invalid move - this shouldn't happen but prevents crash
@@ -50,32 +98,38 @@ lczero::V6TrainingData get_v6_training_data(
 #endif
   }
 
-  // Populate planes
-  int transform = 0;
-  lczero::InputPlanes planes = lczero::EncodePositionForNN(
-      input_format, history, 8, lczero::FillEmptyHistory::FEN_ONLY, &transform);
-
-  // V6 stores first 104 planes (8 history * 13 planes)
-  for (size_t i = 0; i < 104 && i < planes.size(); ++i) {
-    result.planes[i] = lczero::ReverseBitsInBytes(planes[i].mask);
-  }
-
   const auto& position = history.Last();
   const auto& castlings = position.GetBoard().castlings();
 
-  // Populate castlings
-  result.castling_us_ooo = castlings.we_can_000() ? 1 : 0;
-  result.castling_us_oo = castlings.we_can_00() ? 1 : 0;
-  result.castling_them_ooo = castlings.they_can_000() ? 1 : 0;
-  result.castling_them_oo = castlings.they_can_00() ? 1 : 0;
-
-  // Side to move and enpassant
-  result.side_to_move_or_enpassant = 0;
-  if (position.IsBlackToMove()) {
-    result.side_to_move_or_enpassant = 1;
+  // Populate castlings. Formats with 960 castling get the rook's file as a
+  // bit mask, older ones just 1.
+  uint8_t queen_side = 1;
+  uint8_t king_side = 1;
+  if constexpr (has_960_castling(kFormat)) {
+    queen_side <<= castlings.queenside_rook().idx;
+    king_side <<= castlings.kingside_rook().idx;
+  }
+  result.castling_us_ooo = castlings.we_can_000() ? queen_side : 0;
+  result.castling_us_oo = castlings.we_can_00() ? king_side : 0;
+  result.castling_them_ooo = castlings.they_can_000() ? queen_side : 0;
+  result.castling_them_oo = castlings.they_can_00() ? king_side : 0;
+
+  if constexpr (is_canonical(kFormat)) {
+    // En passant file mask, and the transform so that the trainer can map
+    // the policy back to real moves.
+    result.side_to_move_or_enpassant =
+        position.GetBoard().en_passant().as_int() >> 56;
+    if (transform & lczero::FlipTransform) {
+      result.side_to_move_or_enpassant =
+          lczero::ReverseBitsInBytes(result.side_to_move_or_enpassant);
+    }
+    result.invariance_info =
+        transform | (position.IsBlackToMove() ? (1u << 7) : 0u);
+  } else {
+    // Side to move and enpassant
+    result.side_to_move_or_enpassant = position.IsBlackToMove() ? 1 : 0;
+    result.invariance_info = 0;
   }
-
-  result.invariance_info = 0;
 
   result.rule50_count = position.GetRule50Ply();
 
@@ -110,11 +164,84 @@ lczero::V6TrainingData get_v6_training_data(
   result.policy_kld = 0.0f;
 
   // Use the already-validated played_idx (or 0 if invalid)
-  result.played_idx = (played_idx < 1858) ? played_idx : 0;
+  result.played_idx = (played_idx < kPolicySize) ? played_idx : 0;
 
   // best_idx with bounds check
-  uint16_t best_idx = lczero::MoveToNNIndex(best_move, 0);
-  result.best_idx = (best_idx < 1858) ? best_idx : result.played_idx;
+  uint16_t best_idx = policy_index(best_move, transform);
+  result.best_idx = (best_idx < kPolicySize) ? best_idx : result.played_idx;
+}
 
-  return result;
+}  // namespace
+
+void fill_v6_training_data(
+    lczero::V6TrainingData& result, lczero::GameResult game_result,
+    const lczero::PositionHistory& history, lczero::Move played_move,
+    const lczero::MoveList& legal_moves, float Q, lczero::Move best_move,
+    uint32_t visits, HistoryEncoder* history_encoder) {
+  fill_v6_training_data_for<pblczero::NetworkFormat::INPUT_CLASSICAL_112_PLANE>(
+      result, game_result, history, played_move, legal_moves, Q, best_move,
+      visits, history_encoder);
+}
+
+TrainingDataFiller training_data_filler(
+    pblczero::NetworkFormat::InputFormat format) {
+  switch (format) {
+    case pblczero::NetworkFormat::INPUT_CLASSICAL_112_PLANE:
+      return fill_v6_training_data;
+    case pblczero::NetworkFormat::INPUT_112_WITH_CASTLING_PLANE:
+      return fill_v6_training_data_for<
+          pblczero::NetworkFormat::INPUT_112_WITH_CASTLING_PLANE>;
+    case pblczero::NetworkFormat::INPUT_112_WITH_CANONICALIZATION:
+      return fill_v6_training_data_for<
+          pblczero::NetworkFormat::INPUT_112_WITH_CANONICALIZATION>;
+    case pblczero::NetworkFormat::INPUT_112_WITH_CANONICALIZATION_HECTOPLIES:
+      return fill_v6_training_data_for<
+          pblczero::NetworkFormat::INPUT_112_WITH_CANONICALIZATION_HECTOPLIES>;
+    case pblczero::NetworkFormat::
+        INPUT_112_WITH_CANONICALIZATION_HECTOPLIES_ARMAGEDDON:
+      return fill_v6_training_data_for<
+          pblczero::NetworkFormat::
+              INPUT_112_WITH_CANONICALIZATION_HECTOPLIES_ARMAGEDDON>;
+    case pblczero::NetworkFormat::INPUT_112_WITH_CANONICALIZATION_V2:
+      return fill_v6_training_data_for<
+          pblczero::NetworkFormat::INPUT_112_WITH_CANONICALIZATION_V2>;
+    case pblczero::NetworkFormat::INPUT_112_WITH_CANONICALIZATION_V2_ARMAGEDDON:
+      return fill_v6_training_data_for<
+          pblczero::NetworkFormat::INPUT_112_WITH_CANONICALIZATION_V2_ARMAGEDDON>;
+    default:
+      return nullptr;
+  }
+}
+
+bool parse_input_format(const std::string& name,
+                        pblczero::NetworkFormat::InputFormat& format) {
+  static const std::pair<const char*, pblczero::NetworkFormat::InputFormat>
+      kNames[] = {
+          {"classical", pblczero::NetworkFormat::INPUT_CLASSICAL_112_PLANE},
+          {"castling", pblczero::NetworkFormat::INPUT_112_WITH_CASTLING_PLANE},
+          {"canonical",
+           pblczero::NetworkFormat::INPUT_112_WITH_CANONICALIZATION},
+          {"hectoplies",
+           pblczero::NetworkFormat::INPUT_112_WITH_CANONICALIZATION_HECTOPLIES},
+          {"hectoplies-armageddon",
+           pblczero::NetworkFormat::
+               INPUT_112_WITH_CANONICALIZATION_HECTOPLIES_ARMAGEDDON},
+          {"canonical-v2",
+           pblczero::NetworkFormat::INPUT_112_WITH_CANONICALIZATION_V2},
+          {"canonical-v2-armageddon",
+           pblczero::NetworkFormat::
+               INPUT_112_WITH_CANONICALIZATION_V2_ARMAGEDDON},
+      };
+  for (const auto& [key, value] : kNames) {
+    if (name == key) {
+      format = value;
+      return true;
+    }
+  }
+  // Also accept the numeric value from net.proto.
+  char* end = nullptr;
+  long value = std::strtol(name.c_str(), &end, 10);
+  if (end == name.c_str() || *end != '\0') return false;
+  format = static_cast<pblczero::NetworkFormat::InputFormat>(value);
+  return training_data_filler(format) != nullptr;
 }
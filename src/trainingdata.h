@@ -1,13 +1,43 @@
 #if !defined(TRAININGDATA_H_INCLUDED)
 #define TRAININGDATA_H_INCLUDED
 
+#include <string>
+
+#include "HistoryEncoder.h"
 #include "neural/encoder.h"
 #include "neural/network.h"
 #include "trainingdata/trainingdata_v6.h"
 
-lczero::V6TrainingData get_v6_training_data(
-        lczero::GameResult game_result, const lczero::PositionHistory& history,
-        lczero::Move played_move, lczero::MoveList legal_moves, float Q,
-        lczero::Move best_move, uint32_t visits);
+// A V6 record with the fields every position shares already set: version,
+// input format, and -1 (illegal) for every policy entry.
+const lczero::V6TrainingData& v6_template_record();
+
+// Fills the position dependent fields of result, which must start out as a
+// copy of v6_template_record(), e.g. from ChunkSink::Append(), for the
+// classical 112 plane input format.
+void fill_v6_training_data(
+        lczero::V6TrainingData& result, lczero::GameResult game_result,
+        const lczero::PositionHistory& history, lczero::Move played_move,
+        const lczero::MoveList& legal_moves, float Q, lczero::Move best_move,
+        uint32_t visits, HistoryEncoder* history_encoder = nullptr);
+
+// fill_v6_training_data for one input format. The history encoder only
+// applies to the classical format, the others need EncodePositionForNN.
+using TrainingDataFiller = void (*)(
+        lczero::V6TrainingData& result, lczero::GameResult game_result,
+        const lczero::PositionHistory& history, lczero::Move played_move,
+        const lczero::MoveList& legal_moves, float Q, lczero::Move best_move,
+        uint32_t visits, HistoryEncoder* history_encoder);
+
+// Returns the filler compiled for format, or nullptr if it is not supported.
+// Look it up once and keep it, e.g. in Options.
+TrainingDataFiller training_data_filler(
+        pblczero::NetworkFormat::InputFormat format);
+
+// Parses an -input-format value: classical, castling, canonical, hectoplies,
+// hectoplies-armageddon, canonical-v2, canonical-v2-armageddon, or the
+// format's number in net.proto.
+bool parse_input_format(const std::string& name,
+                        pblczero::NetworkFormat::InputFormat& format);
 
 #endif
\ No newline at end of file